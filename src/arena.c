@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <SDL2/SDL.h>
+#include "types.h"
+#include "constants.h"
+
+/* allocator hook: once memory_install_hooks has run, every SDL_malloc, SDL_calloc and
+ * SDL_realloc, made by SDL itself or by the game's arenas, is counted here before being passed
+ * on to the allocator SDL had before */
+SDL_atomic_t _memory_allocations;
+SDL_malloc_func _memory_malloc;
+SDL_calloc_func _memory_calloc;
+SDL_realloc_func _memory_realloc;
+SDL_free_func _memory_free;
+
+void * _memory_counting_malloc(size_t size)
+{
+  SDL_AtomicAdd(&_memory_allocations, 1);
+  return _memory_malloc(size);
+}
+
+void * _memory_counting_calloc(size_t count, size_t size)
+{
+  SDL_AtomicAdd(&_memory_allocations, 1);
+  return _memory_calloc(count, size);
+}
+
+void * _memory_counting_realloc(void *p, size_t size)
+{
+  SDL_AtomicAdd(&_memory_allocations, 1);
+  return _memory_realloc(p, size);
+}
+
+/* must run before SDL_Init, so nothing is freed by a different allocator than it came from */
+void memory_install_hooks(void)
+{
+  SDL_GetMemoryFunctions(&_memory_malloc, &_memory_calloc, &_memory_realloc, &_memory_free);
+  if (SDL_SetMemoryFunctions(_memory_counting_malloc, _memory_counting_calloc,
+			     _memory_counting_realloc, _memory_free) != 0)
+    fprintf(stderr, "[error]: %s, heap allocations will not be counted\n", SDL_GetError());
+}
+
+/* heap allocations so far; compare two readings to check a stretch of play allocated nothing */
+unsigned long memory_allocation_count(void)
+{
+  return (unsigned long)SDL_AtomicGet(&_memory_allocations);
+}
+
+/* one zeroed block of size bytes, handed out front to back by arena_alloc and freed all at
+ * once by arena_destroy */
+Arena * arena_create(size_t size)
+{
+  Arena *a = SDL_calloc(1, sizeof(Arena) + size);
+
+  if (a == NULL) {
+    fprintf(stderr, "[error]: Could not allocate a %lu byte arena\n", (unsigned long)size);
+    return NULL;
+  }
+  a->base = (unsigned char *)(a + 1);
+  a->size = size;
+  a->used = 0;
+  return a;
+}
+
+/* ARENA_ALIGNMENT aligned, zeroed memory from the arena; NULL once it is used up */
+void * arena_alloc(Arena *a, size_t size)
+{
+  uintptr_t start = ((uintptr_t)(a->base + a->used) + ARENA_ALIGNMENT - 1) & ~(uintptr_t)(ARENA_ALIGNMENT - 1);
+  size_t offset = start - (uintptr_t)a->base;
+
+  if (offset + size > a->size) {
+    fprintf(stderr, "[error]: Arena out of memory, %lu of %lu bytes used\n",
+	    (unsigned long)a->used, (unsigned long)a->size);
+    return NULL;
+  }
+  a->used = offset + size;
+  return a->base + offset;
+}
+
+void arena_destroy(Arena *a)
+{
+  SDL_free(a);
+}
@@ -0,0 +1,394 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "types.h"
+#include "constants.h"
+
+/* the autopilot follows a precomputed Hamiltonian cycle, which on its own is guaranteed to
+ * fill the board: as long as the body lies along the cycle from tail to head, every cell from
+ * the head forward to the tail is free, so the tail stays reachable. It takes a shortcut to
+ * the food when one is safe, i.e. when it lands strictly inside that free stretch with room to
+ * grow, and doesn't jump past the food. Shortcuts are chosen with a breadth-first distance field
+ * from the food, which is only rebuilt when the food moves, so a typical tick costs a handful of
+ * table lookups. A board with both sides odd has no such cycle: there it heads for the food
+ * by the same distance field, but only by moves after which a flood over the free cells can
+ * still reach the tail, and makes the move with the most room when none can */
+
+#define AUTOPILOT_UNREACHABLE 0xffffffffu
+/* cells kept free between a shortcut and the tail, for the growth of eating on the way */
+#define AUTOPILOT_SHORTCUT_MARGIN 4
+/* no more shortcuts once the snake covers this share of the board, in percent */
+#define AUTOPILOT_SHORTCUT_MAX_FILL 50
+#define AUTOPILOT_BENCH_INITIAL_LENGTH 4
+/* without a cycle the autopilot can circle after its tail for good, so a bench game that goes
+ * this many ticks per cell without eating is over, as in headless runs */
+#define AUTOPILOT_BENCH_STARVATION_TICKS_PER_CELL 4
+
+/* arena.c functions */
+void * arena_alloc(Arena *a, size_t size);
+Arena * arena_create(size_t size);
+void arena_destroy(Arena *a);
+
+/* rng.c functions */
+void rng_seed(Rng *r, Uint64 seed, Uint64 stream);
+Uint32 rng_below(Rng *r, Uint32 bound);
+
+size_t autopilot_arena_size(unsigned int width, unsigned int height)
+{
+  return sizeof(Autopilot) + 5 * ((size_t)width * height * sizeof(Uint32)) + 6 * ARENA_ALIGNMENT;
+}
+
+/* number the cells along a Hamiltonian cycle. With an even height: row 0 right to left, rows 1
+ * and on back and forth over all but the last column, then up the last column. Odd rows run
+ * left to right; when height / 2 is even the cycle is walked the other way round, so either
+ * way row height / 2 runs east and the starting snake lies along the cycle. With an odd height
+ * and even width the same pattern is turned on its side, and the starting snake lies across
+ * its columns, off the cycle, until it has moved its length along it (see settled). With both
+ * sides odd there is no such cycle */
+bool _autopilot_build_cycle(Autopilot *a)
+{
+  unsigned int w = a->width, h = a->height;
+  Uint32 i = 0, swap;
+
+  if (w < 2 || h < 2 || (w % 2 && h % 2))
+    return false;
+  if (h % 2 == 0) {
+    for (unsigned int x = w; x-- > 0;)
+      a->cycle_cell[i++] = x;
+    for (unsigned int y = 1; y < h; y++) {
+      for (unsigned int k = 0; k + 1 < w; k++)
+	a->cycle_cell[i++] = y * w + (y % 2 ? k : w - 2 - k);
+    }
+    for (unsigned int y = h - 1; y >= 1; y--)
+      a->cycle_cell[i++] = y * w + w - 1;
+    for (Uint32 k = 0; (h / 2) % 2 == 0 && k < i / 2; k++) {
+      swap = a->cycle_cell[k];
+      a->cycle_cell[k] = a->cycle_cell[i - 1 - k];
+      a->cycle_cell[i - 1 - k] = swap;
+    }
+  } else {
+    for (unsigned int y = h; y-- > 0;)
+      a->cycle_cell[i++] = y * w;
+    for (unsigned int x = 1; x < w; x++) {
+      for (unsigned int k = 0; k + 1 < h; k++)
+	a->cycle_cell[i++] = (x % 2 ? k : h - 2 - k) * w + x;
+    }
+    for (unsigned int x = w - 1; x >= 1; x--)
+      a->cycle_cell[i++] = (h - 1) * w + x;
+  }
+  for (Uint32 k = 0; k < i; k++)
+    a->cycle_index[a->cycle_cell[k]] = k;
+  return true;
+}
+
+Autopilot * autopilot_create(Arena *arena, unsigned int width, unsigned int height)
+{
+  size_t cells = (size_t)width * height;
+  Autopilot *a = arena_alloc(arena, sizeof(Autopilot));
+
+  if (a == NULL)
+    return NULL;
+  a->width = width;
+  a->height = height;
+  a->cycle_index = arena_alloc(arena, cells * sizeof(Uint32));
+  a->cycle_cell = arena_alloc(arena, cells * sizeof(Uint32));
+  a->food_distance = arena_alloc(arena, cells * sizeof(Uint32));
+  a->queue = arena_alloc(arena, cells * sizeof(Uint32));
+  a->reached = arena_alloc(arena, cells * sizeof(Uint32));
+  if (a->cycle_index == NULL || a->cycle_cell == NULL || a->food_distance == NULL || a->queue == NULL
+      || a->reached == NULL) {
+    fprintf(stderr, "[error]: Could not allocate memory for the autopilot\n");
+    return NULL;
+  }
+  if (!_autopilot_build_cycle(a)) {
+    fprintf(stderr, "[info]: no Hamiltonian cycle on a %ux%u board, the autopilot can't guarantee a win\n",
+	    width, height);
+    a->cycle_index = NULL;
+    a->cycle_cell = NULL;
+  }
+  a->field_food = AUTOPILOT_UNREACHABLE;
+  a->expected_head = AUTOPILOT_UNREACHABLE;
+  return a;
+}
+
+bool _autopilot_occupied(const Uint64 *occupancy, Uint32 cell)
+{
+  return (occupancy[cell / 64] >> (cell % 64)) & 1;
+}
+
+/* the neighbour of cell in direction d, or AUTOPILOT_UNREACHABLE off the board */
+Uint32 _autopilot_neighbour(Autopilot *a, Uint32 cell, int d)
+{
+  unsigned int x = cell % a->width, y = cell / a->width;
+
+  switch (d) {
+  case NORTH:
+    return y > 0 ? cell - a->width : AUTOPILOT_UNREACHABLE;
+  case SOUTH:
+    return y + 1 < a->height ? cell + a->width : AUTOPILOT_UNREACHABLE;
+  case EAST:
+    return x + 1 < a->width ? cell + 1 : AUTOPILOT_UNREACHABLE;
+  default:
+    return x > 0 ? cell - 1 : AUTOPILOT_UNREACHABLE;
+  }
+}
+
+/* flood the free cells outward from the food */
+void _autopilot_search(Autopilot *a, const Uint64 *occupancy, Uint32 food)
+{
+  Uint64 start = SDL_GetPerformanceCounter();
+  size_t cells = (size_t)a->width * a->height;
+  Uint32 first = 0, last = 0, cell, next;
+
+  memset(a->food_distance, 0xff, cells * sizeof(Uint32));
+  a->food_distance[food] = 0;
+  a->queue[last++] = food;
+  while (first < last) {
+    cell = a->queue[first++];
+    for (int d = NORTH; d <= WEST; d++) {
+      next = _autopilot_neighbour(a, cell, d);
+      if (next == AUTOPILOT_UNREACHABLE || a->food_distance[next] != AUTOPILOT_UNREACHABLE)
+	continue;
+      if (_autopilot_occupied(occupancy, next))
+	continue;
+      a->food_distance[next] = a->food_distance[cell] + 1;
+      a->queue[last++] = next;
+    }
+  }
+  a->field_food = food;
+  a->stats.searches++;
+  a->stats.search_time += SDL_GetPerformanceCounter() - start;
+}
+
+/* flood the free cells outward from a move into from; true if the flood gets to the tail, with
+ * the cells it got to in *room. A move that eats leaves the tail in place for a tick, so then
+ * from itself being next to the tail doesn't count */
+bool _autopilot_reaches_tail(Autopilot *a, const Uint64 *occupancy, Uint32 from, Uint32 tail, bool eats,
+			     Uint32 *room)
+{
+  Uint32 first = 0, last = 0, cell, next;
+  bool tail_reached = false;
+
+  a->flood++;
+  a->reached[from] = a->flood;
+  a->queue[last++] = from;
+  while (first < last) {
+    cell = a->queue[first++];
+    for (int d = NORTH; d <= WEST; d++) {
+      next = _autopilot_neighbour(a, cell, d);
+      if (next == AUTOPILOT_UNREACHABLE || a->reached[next] == a->flood)
+	continue;
+      if (next == tail) {
+	tail_reached |= !eats || cell != from;
+	continue;
+      }
+      if (_autopilot_occupied(occupancy, next))
+	continue;
+      a->reached[next] = a->flood;
+      a->queue[last++] = next;
+    }
+  }
+  *room = last;
+  return tail_reached;
+}
+
+/* no cycle to follow: the move closest to the food after which the tail is still reachable,
+ * or failing that the one with the most cells left to move in */
+Direction _autopilot_chase(Autopilot *a, const Uint64 *occupancy, Uint32 head, Uint32 tail, Uint32 food,
+			   Direction current)
+{
+  Uint32 next, room, best_distance = AUTOPILOT_UNREACHABLE, most_room = 0;
+  Direction best = current, roomiest = current;
+  bool safe = false;
+
+  for (int d = NORTH; d <= WEST; d++) {
+    next = _autopilot_neighbour(a, head, d);
+    if (next == AUTOPILOT_UNREACHABLE || _autopilot_occupied(occupancy, next))
+      continue;
+    if (_autopilot_reaches_tail(a, occupancy, next, tail, next == food, &room)) {
+      /* unreachable food is as far as it gets, which still beats an unsafe move */
+      if (!safe || a->food_distance[next] < best_distance
+	  || (a->food_distance[next] == best_distance && room > most_room)) {
+	best_distance = a->food_distance[next];
+	most_room = room;
+	best = d;
+	safe = true;
+      }
+    } else if (!safe && room > most_room) {
+      most_room = room;
+      roomiest = d;
+    }
+  }
+  return safe ? best : roomiest;
+}
+
+/* steps along the cycle from cell a to cell b */
+Uint32 _autopilot_cycle_distance(Autopilot *a, Uint32 from, Uint32 to)
+{
+  Uint32 cells = a->width * a->height;
+  return (a->cycle_index[to] + cells - a->cycle_index[from]) % cells;
+}
+
+/* pick a direction for the next move. occupancy is the body's bitset (index y * width + x),
+ * head, tail and food are cell indices and current is the direction the snake is moving in */
+Direction autopilot_decide(Autopilot *a, const Uint64 *occupancy, Uint32 head, Uint32 tail,
+			   Uint32 food, unsigned int length, Direction current)
+{
+  Uint64 start = SDL_GetPerformanceCounter(), elapsed;
+  Uint32 cells = a->width * a->height;
+  Uint32 best = AUTOPILOT_UNREACHABLE, best_distance = AUTOPILOT_UNREACHABLE, next;
+  Direction best_direction = current;
+  bool shortcuts = true;
+  Uint32 tail_gap = 0, food_gap = 0, jump;
+
+  /* a new food, or a new game that happened to put the food in the same place; without a cycle
+   * the field steers every move, so it follows the body as it goes */
+  if (food != a->field_food || length < a->field_length || a->cycle_index == NULL)
+    _autopilot_search(a, occupancy, food);
+  a->field_length = length;
+
+  if (a->cycle_index == NULL) {
+    best_direction = _autopilot_chase(a, occupancy, head, tail, food, current);
+  } else {
+    /* a new game, or a move the autopilot didn't make: the body may be out of cycle order */
+    a->settled = head == a->expected_head ? a->settled + 1 : 0;
+    best = a->cycle_cell[(a->cycle_index[head] + 1) % cells];
+    best_distance = a->food_distance[best];
+    shortcuts = a->settled >= length && (Uint64)length * 100 < (Uint64)cells * AUTOPILOT_SHORTCUT_MAX_FILL;
+    tail_gap = _autopilot_cycle_distance(a, head, tail);
+    food_gap = _autopilot_cycle_distance(a, head, food);
+    for (int d = NORTH; d <= WEST; d++) {
+      next = _autopilot_neighbour(a, head, d);
+      if (next == AUTOPILOT_UNREACHABLE || _autopilot_occupied(occupancy, next))
+	continue;
+      if (next == best)
+	best_direction = d;
+      if (!shortcuts)
+	continue;
+      jump = _autopilot_cycle_distance(a, head, next);
+      if (jump + AUTOPILOT_SHORTCUT_MARGIN >= tail_gap || jump > food_gap)
+	continue;
+      if (a->food_distance[next] < best_distance) {
+	best_distance = a->food_distance[next];
+	best = next;
+	best_direction = d;
+      }
+    }
+    a->expected_head = _autopilot_neighbour(a, head, best_direction);
+  }
+
+  elapsed = SDL_GetPerformanceCounter() - start;
+  a->stats.decisions++;
+  a->stats.decision_time += elapsed;
+  if (elapsed > a->stats.decision_max)
+    a->stats.decision_max = elapsed;
+  return best_direction;
+}
+
+void autopilot_merge_stats(AutopilotStats *into, const AutopilotStats *from)
+{
+  into->decisions += from->decisions;
+  into->decision_time += from->decision_time;
+  if (from->decision_max > into->decision_max)
+    into->decision_max = from->decision_max;
+  into->searches += from->searches;
+  into->search_time += from->search_time;
+}
+
+void autopilot_report(const AutopilotStats *s, const char *label)
+{
+  double us = 1000000.0 / SDL_GetPerformanceFrequency();
+
+  fprintf(stdout, "[info]: %s: %llu decisions, mean %.3f us, max %.1f us; %llu distance fields, mean %.1f us\n",
+	  label, (unsigned long long)s->decisions,
+	  s->decisions > 0 ? s->decision_time * us / s->decisions : 0.0, s->decision_max * us,
+	  (unsigned long long)s->searches, s->searches > 0 ? s->search_time * us / s->searches : 0.0);
+}
+
+/* one autopilot game on a width x height board, with its own minimal board model so the size
+ * isn't limited to the game's; played until the board is full, the snake dies, or max_ticks
+ * (0 for no limit). The food follows seed */
+int autopilot_bench(unsigned int width, unsigned int height, unsigned long max_ticks, Uint64 seed)
+{
+  size_t cells = (size_t)width * height, words = (cells + 63) / 64;
+  Arena *arena;
+  Autopilot *a;
+  Uint64 *occupancy;
+  Uint32 *body, head_slot, tail_slot, length, food, next = 0, free_count;
+  Direction d = EAST;
+  unsigned long tick = 0, last_food_tick = 0;
+  Uint64 start;
+  Rng rng;
+
+  if (width < AUTOPILOT_BENCH_INITIAL_LENGTH + 1 || height < 2) {
+    fprintf(stderr, "[error]: a %ux%u board is too small for the autopilot benchmark\n", width, height);
+    return -1;
+  }
+  arena = arena_create(autopilot_arena_size(width, height) + words * sizeof(Uint64) + cells * sizeof(Uint32)
+		       + 2 * ARENA_ALIGNMENT);
+  if (arena == NULL)
+    return -1;
+  occupancy = arena_alloc(arena, words * sizeof(Uint64));
+  body = arena_alloc(arena, cells * sizeof(Uint32));
+  a = autopilot_create(arena, width, height);
+  if (occupancy == NULL || body == NULL || a == NULL) {
+    arena_destroy(arena);
+    return -1;
+  }
+  /* the same start as the game: a short snake heading east from the left edge, mid board */
+  for (length = 0; length < AUTOPILOT_BENCH_INITIAL_LENGTH; length++) {
+    body[length] = (height / 2) * width + length;
+    occupancy[body[length] / 64] |= (Uint64)1 << (body[length] % 64);
+  }
+  tail_slot = 0;
+  head_slot = length - 1;
+  rng_seed(&rng, seed, 0);
+  do {
+    food = rng_below(&rng, (Uint32)cells);
+  } while (_autopilot_occupied(occupancy, food));
+
+  start = SDL_GetPerformanceCounter();
+  for (; max_ticks == 0 || tick < max_ticks; tick++) {
+    d = autopilot_decide(a, occupancy, body[head_slot], body[tail_slot], food, length, d);
+    next = _autopilot_neighbour(a, body[head_slot], d);
+    if (next == AUTOPILOT_UNREACHABLE || _autopilot_occupied(occupancy, next))
+      break;
+    if (tick - last_food_tick > AUTOPILOT_BENCH_STARVATION_TICKS_PER_CELL * cells)
+      break;
+    head_slot = (head_slot + 1) % cells;
+    body[head_slot] = next;
+    occupancy[next / 64] |= (Uint64)1 << (next % 64);
+    if (next != food) {
+      occupancy[body[tail_slot] / 64] &= ~((Uint64)1 << (body[tail_slot] % 64));
+      tail_slot = (tail_slot + 1) % cells;
+      continue;
+    }
+    last_food_tick = tick;
+    if (++length == cells) {
+      tick++;
+      break;
+    }
+    /* rejection sampling gets slow on a nearly full board, so count down the free cells then */
+    free_count = (Uint32)(cells - length);
+    if (free_count * 8 > cells) {
+      do {
+	food = rng_below(&rng, (Uint32)cells);
+      } while (_autopilot_occupied(occupancy, food));
+    } else {
+      Uint32 n = rng_below(&rng, free_count);
+      for (food = 0; _autopilot_occupied(occupancy, food) || n-- > 0; food++)
+	;
+    }
+  }
+
+  fprintf(stdout, "[info]: autopilot on %ux%u: %s at length %u of %lu after %lu ticks in %.3f s\n",
+	  width, height, length == cells ? "filled the board" : max_ticks > 0 && tick == max_ticks ? "stopped"
+	  : tick - last_food_tick > AUTOPILOT_BENCH_STARVATION_TICKS_PER_CELL * cells ? "starved" : "died",
+	  length, (unsigned long)cells, tick,
+	  (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency());
+  autopilot_report(&(a->stats), "autopilot");
+  arena_destroy(arena);
+  return 0;
+}
@@ -0,0 +1,287 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "types.h"
+
+#define BATCH_INITIAL_LENGTH 4
+
+/* rng.c functions */
+void rng_seed(Rng *r, Uint64 seed, Uint64 stream);
+Uint32 rng_below(Rng *r, Uint32 bound);
+
+/* Direction values double as array values here: NORTH 0, SOUTH 1, EAST 2, WEST 3, so the
+ * opposite of d is d ^ 1 */
+
+unsigned int _batch_popcount(Uint64 w)
+{
+  w = w - ((w >> 1) & 0x5555555555555555ULL);
+  w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+  w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return (unsigned int)((w * 0x0101010101010101ULL) >> 56);
+}
+
+/* uniform draw over game g's free cells: pick the n-th zero bit of its occupancy bitset */
+void _batch_place_food(Batch *b, unsigned int g)
+{
+  Uint64 *occupancy = b->occupancy + (size_t)g * OCCUPANCY_WORDS;
+  unsigned int n = rng_below(&(b->rng), GRID_CELL_COUNT - b->length[g]);
+
+  for (unsigned int word = 0; word < OCCUPANCY_WORDS; word++) {
+    Uint64 free_bits = ~occupancy[word];
+    unsigned int bits = (word + 1) * 64 <= GRID_CELL_COUNT ? 64 : GRID_CELL_COUNT % 64;
+    unsigned int free_count;
+
+    if (bits < 64)
+      free_bits &= ((Uint64)1 << bits) - 1;
+    free_count = _batch_popcount(free_bits);
+    if (n >= free_count) {
+      n -= free_count;
+      continue;
+    }
+    for (unsigned int bit = 0; bit < bits; bit++) {
+      if (((free_bits >> bit) & 1) && n-- == 0) {
+	b->food_x[g] = (word * 64 + bit) % GRID_COUNT_X;
+	b->food_y[g] = (word * 64 + bit) / GRID_COUNT_X;
+	return;
+      }
+    }
+  }
+}
+
+void _batch_set_cell(Batch *b, unsigned int g, unsigned int cell)
+{
+  b->occupancy[(size_t)g * OCCUPANCY_WORDS + cell / 64] |= (Uint64)1 << (cell % 64);
+}
+
+void _batch_clear_cell(Batch *b, unsigned int g, unsigned int cell)
+{
+  b->occupancy[(size_t)g * OCCUPANCY_WORDS + cell / 64] &= ~((Uint64)1 << (cell % 64));
+}
+
+/* put game g back to the starting position, in place */
+void _batch_reset_game(Batch *b, unsigned int g)
+{
+  Uint16 *body = b->body + (size_t)g * GRID_CELL_COUNT;
+
+  memset(b->occupancy + (size_t)g * OCCUPANCY_WORDS, 0, OCCUPANCY_WORDS * sizeof(Uint64));
+  for (unsigned int i = 0; i < BATCH_INITIAL_LENGTH; i++) {
+    body[i] = (GRID_COUNT_Y / 2) * GRID_COUNT_X + i;
+    _batch_set_cell(b, g, body[i]);
+  }
+  b->body_tail[g] = 0;
+  b->body_head[g] = BATCH_INITIAL_LENGTH - 1;
+  b->head_x[g] = BATCH_INITIAL_LENGTH - 1;
+  b->head_y[g] = GRID_COUNT_Y / 2;
+  b->direction[g] = EAST;
+  b->length[g] = BATCH_INITIAL_LENGTH;
+  b->score[g] = 0;
+  b->ticks[g] = 0;
+  _batch_place_food(b, g);
+}
+
+void batch_destroy(Batch *b)
+{
+  if (b == NULL)
+    return;
+  free(b->head_x);
+  free(b->head_y);
+  free(b->next_x);
+  free(b->next_y);
+  free(b->food_x);
+  free(b->food_y);
+  free(b->direction);
+  free(b->length);
+  free(b->score);
+  free(b->ticks);
+  free(b->body_head);
+  free(b->body_tail);
+  free(b->ate);
+  free(b->done);
+  free(b->done_score);
+  free(b->occupancy);
+  free(b->body);
+  free(b);
+}
+
+Batch * batch_create(unsigned int count, Uint64 seed)
+{
+  Batch *b = calloc(1, sizeof(Batch));
+  if (b == NULL) {
+    fprintf(stderr, "[error]: Could not allocate memory for Batch\n");
+    return NULL;
+  }
+  b->count = count;
+  b->head_x = malloc(count * sizeof(Sint32));
+  b->head_y = malloc(count * sizeof(Sint32));
+  b->next_x = malloc(count * sizeof(Sint32));
+  b->next_y = malloc(count * sizeof(Sint32));
+  b->food_x = malloc(count * sizeof(Sint32));
+  b->food_y = malloc(count * sizeof(Sint32));
+  b->direction = malloc(count * sizeof(Uint32));
+  b->length = malloc(count * sizeof(Uint32));
+  b->score = malloc(count * sizeof(Uint32));
+  b->ticks = malloc(count * sizeof(Uint32));
+  b->body_head = malloc(count * sizeof(Uint32));
+  b->body_tail = malloc(count * sizeof(Uint32));
+  b->ate = calloc(count, sizeof(Uint32));
+  b->done = calloc(count, sizeof(Uint32));
+  b->done_score = calloc(count, sizeof(Uint32));
+  b->occupancy = malloc((size_t)count * OCCUPANCY_WORDS * sizeof(Uint64));
+  b->body = malloc((size_t)count * GRID_CELL_COUNT * sizeof(Uint16));
+  if (!b->head_x || !b->head_y || !b->next_x || !b->next_y || !b->food_x || !b->food_y ||
+      !b->direction || !b->length || !b->score || !b->ticks || !b->body_head || !b->body_tail ||
+      !b->ate || !b->done || !b->done_score || !b->occupancy || !b->body) {
+    fprintf(stderr, "[error]: Could not allocate memory for %u batched games\n", count);
+    batch_destroy(b);
+    return NULL;
+  }
+  rng_seed(&(b->rng), seed, 0);
+  for (unsigned int g = 0; g < count; g++)
+    _batch_reset_game(b, g);
+  return b;
+}
+
+/* kernel: take the requested turn unless it reverses, then compute the next head position */
+void _batch_kernel_move(unsigned int n, const Uint32 *restrict actions, Uint32 *restrict direction,
+			const Sint32 *restrict head_x, const Sint32 *restrict head_y,
+			Sint32 *restrict next_x, Sint32 *restrict next_y)
+{
+  for (unsigned int g = 0; g < n; g++) {
+    Uint32 d = (actions[g] == (direction[g] ^ 1)) ? direction[g] : actions[g];
+    direction[g] = d;
+    next_x[g] = head_x[g] + (Sint32)(d == EAST) - (Sint32)(d == WEST);
+    next_y[g] = head_y[g] + (Sint32)(d == SOUTH) - (Sint32)(d == NORTH);
+  }
+}
+
+/* kernel: wall checks, the _incoming_collision bounds test for every game at once */
+void _batch_kernel_walls(unsigned int n, const Sint32 *restrict next_x, const Sint32 *restrict next_y,
+			 Uint32 *restrict done)
+{
+  for (unsigned int g = 0; g < n; g++)
+    done[g] = ((Uint32)next_x[g] >= GRID_COUNT_X) | ((Uint32)next_y[g] >= GRID_COUNT_Y);
+}
+
+/* kernel: self collision against each game's occupancy bitset */
+void _batch_kernel_body(unsigned int n, const Sint32 *restrict next_x, const Sint32 *restrict next_y,
+			const Uint64 *restrict occupancy, Uint32 *restrict done)
+{
+  for (unsigned int g = 0; g < n; g++) {
+    /* point games that already hit a wall at cell 0, so the load stays in bounds */
+    Uint32 cell = done[g] ? 0 : (Uint32)(next_y[g] * GRID_COUNT_X + next_x[g]);
+    Uint32 hit = (Uint32)(occupancy[(size_t)g * OCCUPANCY_WORDS + cell / 64] >> (cell % 64)) & 1;
+    done[g] |= hit;
+  }
+}
+
+/* kernel: food hits */
+void _batch_kernel_food(unsigned int n, const Sint32 *restrict next_x, const Sint32 *restrict next_y,
+			const Sint32 *restrict food_x, const Sint32 *restrict food_y,
+			const Uint32 *restrict done, Uint32 *restrict ate)
+{
+  for (unsigned int g = 0; g < n; g++)
+    ate[g] = (next_x[g] == food_x[g]) & (next_y[g] == food_y[g]) & (done[g] ^ 1);
+}
+
+/* per game bookkeeping the kernels can't do: move the body ring, place food, reset the dead */
+void _batch_commit(Batch *b)
+{
+  for (unsigned int g = 0; g < b->count; g++) {
+    Uint16 *body = b->body + (size_t)g * GRID_CELL_COUNT;
+    Uint32 cell;
+
+    b->ticks[g]++;
+    if (b->done[g]) {
+      b->done_score[g] = b->score[g];
+      _batch_reset_game(b, g);
+      continue;
+    }
+    cell = (Uint32)(b->next_y[g] * GRID_COUNT_X + b->next_x[g]);
+    if (!b->ate[g]) {
+      _batch_clear_cell(b, g, body[b->body_tail[g]]);
+      if (++b->body_tail[g] == GRID_CELL_COUNT)
+	b->body_tail[g] = 0;
+    }
+    if (++b->body_head[g] == GRID_CELL_COUNT)
+      b->body_head[g] = 0;
+    body[b->body_head[g]] = (Uint16)cell;
+    _batch_set_cell(b, g, cell);
+    b->head_x[g] = b->next_x[g];
+    b->head_y[g] = b->next_y[g];
+    if (b->ate[g]) {
+      b->length[g]++;
+      b->score[g]++;
+      /* a full board is a win, and the end of that game */
+      if (b->length[g] == GRID_CELL_COUNT) {
+	b->done[g] = 1;
+	b->done_score[g] = b->score[g];
+	_batch_reset_game(b, g);
+      } else {
+	_batch_place_food(b, g);
+      }
+    }
+  }
+}
+
+/* advance every game in the batch by one tick; actions holds one Direction per game.
+ * Afterwards ate and done say what happened, and finished games have already restarted */
+void batch_step(Batch *b, const Uint32 *actions)
+{
+  _batch_kernel_move(b->count, actions, b->direction, b->head_x, b->head_y, b->next_x, b->next_y);
+  _batch_kernel_walls(b->count, b->next_x, b->next_y, b->done);
+  _batch_kernel_body(b->count, b->next_x, b->next_y, b->occupancy, b->done);
+  _batch_kernel_food(b->count, b->next_x, b->next_y, b->food_x, b->food_y, b->done, b->ate);
+  _batch_commit(b);
+}
+
+/* kernel: a cheap vectorizable bot for benchmarking, close the larger gap to the food first */
+void batch_policy_toward_food(Batch *b, Uint32 *restrict actions)
+{
+  for (unsigned int g = 0; g < b->count; g++) {
+    Sint32 dx = b->food_x[g] - b->head_x[g];
+    Sint32 dy = b->food_y[g] - b->head_y[g];
+    Sint32 ax = dx < 0 ? -dx : dx;
+    Sint32 ay = dy < 0 ? -dy : dy;
+    Uint32 horizontal = dx > 0 ? EAST : WEST;
+    Uint32 vertical = dy > 0 ? SOUTH : NORTH;
+    actions[g] = ax >= ay ? horizontal : vertical;
+  }
+}
+
+/* step count games in lockstep for ticks ticks and report throughput */
+int batch_run(unsigned int count, unsigned long ticks, Uint64 seed)
+{
+  Batch *b;
+  Uint32 *actions;
+  Uint64 start_counter, episodes = 0, episode_score = 0;
+  double seconds;
+
+  if ((b = batch_create(count, seed)) == NULL)
+    return -1;
+  if ((actions = malloc(count * sizeof(Uint32))) == NULL) {
+    fprintf(stderr, "[error]: Could not allocate memory for batch actions\n");
+    batch_destroy(b);
+    return -1;
+  }
+
+  start_counter = SDL_GetPerformanceCounter();
+  for (unsigned long t = 0; t < ticks; t++) {
+    batch_policy_toward_food(b, actions);
+    batch_step(b, actions);
+    for (unsigned int g = 0; g < count; g++) {
+      episodes += b->done[g];
+      episode_score += b->done[g] ? b->done_score[g] : 0;
+    }
+  }
+  seconds = (double)(SDL_GetPerformanceCounter() - start_counter) / SDL_GetPerformanceFrequency();
+
+  fprintf(stdout, "[info]: %u games x %lu ticks in %.3f s (%.0f game ticks/s), "
+	  "%llu episodes finished, mean score %.2f\n",
+	  count, ticks, seconds, seconds > 0 ? (double)count * ticks / seconds : 0.0,
+	  (unsigned long long)episodes, episodes > 0 ? (double)episode_score / episodes : 0.0);
+  free(actions);
+  batch_destroy(b);
+  return 0;
+}
@@ -0,0 +1,298 @@
+#include <stdio.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "types.h"
+#include "constants.h"
+
+/* a captured frame of Capture c: the whole window, RGBA bytes in the file */
+#define CAPTURE_PIXELS(c) ((size_t)(c)->width * (c)->height)
+#define CAPTURE_FRAME_BYTES(c) (CAPTURE_PIXELS(c) * 4)
+#define CAPTURE_PNG_ROW_BYTES(c) (1 + (size_t)(c)->width * 4)
+#define CAPTURE_PNG_BYTES(c) (CAPTURE_PNG_ROW_BYTES(c) * (c)->height)
+/* PNG image data is written as uncompressed deflate blocks, which hold at most this much */
+#define CAPTURE_DEFLATE_BLOCK 65535
+#define CAPTURE_ADLER_RUN 5552
+#define CAPTURE_PATH_MAX 4096
+
+/* arena.c functions */
+Arena * arena_create(size_t size);
+void * arena_alloc(Arena *a, size_t size);
+void arena_destroy(Arena *a);
+
+/* software framebuffer words are 0xAARRGGBB; reorder them into R, G, B, A bytes in place */
+void _capture_argb_to_rgba(Capture *c, Uint8 *pixels)
+{
+  Uint32 p;
+
+  for (size_t i = 0; i < CAPTURE_PIXELS(c); i++) {
+    memcpy(&p, pixels + i * 4, 4);
+    pixels[i * 4] = (Uint8)(p >> 16);
+    pixels[i * 4 + 1] = (Uint8)(p >> 8);
+    pixels[i * 4 + 2] = (Uint8)p;
+    pixels[i * 4 + 3] = (Uint8)(p >> 24);
+  }
+}
+
+Uint32 _capture_crc(Capture *c, Uint32 crc, const Uint8 *data, size_t length)
+{
+  for (size_t i = 0; i < length; i++)
+    crc = c->crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  return crc;
+}
+
+/* a big-endian 32-bit value into a chunk, and into its checksum */
+bool _capture_png_write_u32(Capture *c, FILE *f, Uint32 value, Uint32 *crc)
+{
+  Uint8 bytes[4] = {(Uint8)(value >> 24), (Uint8)(value >> 16), (Uint8)(value >> 8), (Uint8)value};
+
+  if (crc != NULL)
+    *crc = _capture_crc(c, *crc, bytes, 4);
+  return fwrite(bytes, 1, 4, f) == 4;
+}
+
+bool _capture_png_write(Capture *c, FILE *f, const Uint8 *data, size_t length, Uint32 *crc)
+{
+  *crc = _capture_crc(c, *crc, data, length);
+  return fwrite(data, 1, length, f) == length;
+}
+
+/* an RGBA frame as a PNG: no filtering and stored (uncompressed) deflate blocks, which keeps
+ * the writer fast and free of a zlib dependency at the cost of file size */
+bool _capture_write_png(Capture *c, const Uint8 *rgba, FILE *f)
+{
+  const Uint8 signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  const Uint8 ihdr[13] = {
+    (Uint8)(c->width >> 24), (Uint8)(c->width >> 16), (Uint8)(c->width >> 8), (Uint8)c->width,
+    (Uint8)(c->height >> 24), (Uint8)(c->height >> 16), (Uint8)(c->height >> 8), (Uint8)c->height,
+    8, 6, 0, 0, 0 /* 8 bits per channel, RGBA, deflate, no filtering, no interlacing */
+  };
+  const Uint8 zlib_header[2] = {0x78, 0x01};
+  size_t png_bytes = CAPTURE_PNG_BYTES(c), row_bytes = CAPTURE_PNG_ROW_BYTES(c);
+  size_t blocks = (png_bytes + CAPTURE_DEFLATE_BLOCK - 1) / CAPTURE_DEFLATE_BLOCK;
+  Uint32 a = 1, b = 0, crc;
+  Uint8 block_header[5];
+  size_t offset, length;
+  bool ok;
+
+  /* every row starts with filter type 0, and the image is checksummed as it is laid out */
+  for (int y = 0; y < c->height; y++) {
+    c->png_rows[y * row_bytes] = 0;
+    memcpy(c->png_rows + y * row_bytes + 1, rgba + (size_t)y * c->width * 4, row_bytes - 1);
+  }
+  /* Adler-32, reduced every CAPTURE_ADLER_RUN bytes, the longest run b can't overflow in */
+  for (offset = 0; offset < png_bytes; offset += length) {
+    length = png_bytes - offset < CAPTURE_ADLER_RUN ? png_bytes - offset : CAPTURE_ADLER_RUN;
+    for (size_t i = offset; i < offset + length; i++) {
+      a += c->png_rows[i];
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+  }
+
+  ok = fwrite(signature, 1, sizeof(signature), f) == sizeof(signature);
+  crc = 0xffffffff;
+  ok = ok && _capture_png_write_u32(c, f, sizeof(ihdr), NULL);
+  ok = ok && _capture_png_write(c, f, (const Uint8 *)"IHDR", 4, &crc);
+  ok = ok && _capture_png_write(c, f, ihdr, sizeof(ihdr), &crc);
+  ok = ok && _capture_png_write_u32(c, f, crc ^ 0xffffffff, NULL);
+
+  crc = 0xffffffff;
+  ok = ok && _capture_png_write_u32(c, f, (Uint32)(sizeof(zlib_header) + blocks * 5 + png_bytes + 4), NULL);
+  ok = ok && _capture_png_write(c, f, (const Uint8 *)"IDAT", 4, &crc);
+  ok = ok && _capture_png_write(c, f, zlib_header, sizeof(zlib_header), &crc);
+  for (offset = 0; ok && offset < png_bytes; offset += length) {
+    length = png_bytes - offset < CAPTURE_DEFLATE_BLOCK ? png_bytes - offset : CAPTURE_DEFLATE_BLOCK;
+    block_header[0] = offset + length == png_bytes; /* final block flag, stored type */
+    block_header[1] = (Uint8)length;
+    block_header[2] = (Uint8)(length >> 8);
+    block_header[3] = (Uint8)~length;
+    block_header[4] = (Uint8)(~length >> 8);
+    ok = _capture_png_write(c, f, block_header, sizeof(block_header), &crc)
+      && _capture_png_write(c, f, c->png_rows + offset, length, &crc);
+  }
+  ok = ok && _capture_png_write_u32(c, f, (b << 16) | a, &crc);
+  ok = ok && _capture_png_write_u32(c, f, crc ^ 0xffffffff, NULL);
+
+  crc = 0xffffffff;
+  ok = ok && _capture_png_write_u32(c, f, 0, NULL);
+  ok = ok && _capture_png_write(c, f, (const Uint8 *)"IEND", 4, &crc);
+  ok = ok && _capture_png_write_u32(c, f, crc ^ 0xffffffff, NULL);
+  return ok;
+}
+
+/* save one captured frame; the writer owns its buffer until read moves past it */
+bool _capture_write_frame(Capture *c, unsigned int slot)
+{
+  char path[CAPTURE_PATH_MAX];
+  Uint8 *pixels = c->buffers[slot];
+  FILE *f;
+  bool ok;
+
+  if (c->buffer_argb[slot])
+    _capture_argb_to_rgba(c, pixels);
+  if (!c->png)
+    return fwrite(pixels, 1, CAPTURE_FRAME_BYTES(c), c->raw) == CAPTURE_FRAME_BYTES(c);
+
+  snprintf(path, sizeof(path), "%s/frame_%06lu.png", c->directory, (unsigned long)(c->written + c->failed));
+  f = fopen(path, "wb");
+  if (f == NULL)
+    return false;
+  ok = _capture_write_png(c, pixels, f);
+  return fclose(f) == 0 && ok;
+}
+
+/* the writer thread: sleep until frames come in, save them in order, then hand their buffers
+ * back; once stopped it finishes the frames already captured. Each saved frame's time goes to
+ * timestamps.txt, in the format mkvmerge --timestamps reads */
+int _capture_thread(void *data)
+{
+  Capture *c = data;
+  int read, write;
+  unsigned int slot;
+  bool running;
+
+  do {
+    SDL_SemWait(c->wake);
+    running = SDL_AtomicGet(&(c->running));
+    read = SDL_AtomicGet(&(c->read));
+    write = SDL_AtomicGet(&(c->write));
+    SDL_MemoryBarrierAcquire();
+    for (; read != write; read++) {
+      slot = (unsigned int)read & (CAPTURE_BUFFERS - 1);
+      if (_capture_write_frame(c, slot)) {
+	fprintf(c->timestamps, "%.3f\n", (double)(c->buffer_counter[slot] - c->start_counter) * 1000.0
+		/ SDL_GetPerformanceFrequency());
+	c->written++;
+      } else if (c->failed++ == 0)
+	fprintf(stderr, "[error]: Could not write a captured frame to %s\n", c->directory);
+      /* the buffer is free for the main thread once the frame is out of it */
+      SDL_MemoryBarrierRelease();
+      SDL_AtomicSet(&(c->read), read + 1);
+    }
+  } while (running);
+  return 0;
+}
+
+/* allocate the buffer pool for width x height frames and start the writer; frames go to
+ * directory, which must exist */
+Capture * capture_initialize(const char *directory, bool raw, int width, int height)
+{
+  char path[CAPTURE_PATH_MAX];
+  size_t frame_bytes = (size_t)width * height * 4, png_bytes = (1 + (size_t)width * 4) * height;
+  Arena *arena = arena_create(sizeof(Capture) + CAPTURE_BUFFERS * frame_bytes + png_bytes
+			      + (CAPTURE_BUFFERS + 2) * ARENA_ALIGNMENT);
+  Capture *c;
+
+  if (arena == NULL)
+    return NULL;
+  c = arena_alloc(arena, sizeof(Capture));
+  c->arena = arena;
+  c->width = width;
+  c->height = height;
+  for (int i = 0; i < CAPTURE_BUFFERS; i++)
+    c->buffers[i] = arena_alloc(arena, frame_bytes);
+  c->png_rows = arena_alloc(arena, png_bytes);
+  c->directory = directory;
+  c->png = !raw;
+  for (Uint32 n = 0; n < 256; n++) {
+    Uint32 crc = n;
+    for (int k = 0; k < 8; k++)
+      crc = crc & 1 ? 0xedb88320 ^ (crc >> 1) : crc >> 1;
+    c->crc_table[n] = crc;
+  }
+
+  snprintf(path, sizeof(path), "%s/timestamps.txt", directory);
+  c->timestamps = fopen(path, "w");
+  if (c->timestamps == NULL) {
+    fprintf(stderr, "[error]: Could not open %s for frame capture\n", path);
+    arena_destroy(arena);
+    return NULL;
+  }
+  fprintf(c->timestamps, "# timestamp format v2\n");
+  if (raw) {
+    snprintf(path, sizeof(path), "%s/capture.rgba", directory);
+    c->raw = fopen(path, "wb");
+    if (c->raw == NULL) {
+      fprintf(stderr, "[error]: Could not open %s for frame capture\n", path);
+      fclose(c->timestamps);
+      arena_destroy(arena);
+      return NULL;
+    }
+  }
+  c->start_counter = SDL_GetPerformanceCounter();
+  c->wake = SDL_CreateSemaphore(0);
+  SDL_AtomicSet(&(c->running), 1);
+  c->thread = c->wake != NULL ? SDL_CreateThread(_capture_thread, "capture", c) : NULL;
+  if (c->thread == NULL) {
+    fprintf(stderr, "[error]: %s\n", SDL_GetError());
+    if (c->wake != NULL)
+      SDL_DestroySemaphore(c->wake);
+    if (c->raw != NULL)
+      fclose(c->raw);
+    fclose(c->timestamps);
+    arena_destroy(arena);
+    return NULL;
+  }
+  return c;
+}
+
+/* grab the frame render() just drew, before it is presented. Called from the game loop, so it
+ * never waits: with every buffer still queued for the writer the frame is dropped and counted.
+ * So is a frame of another size, drawn after a display scale change resized the output */
+void capture_frame(Capture *c, GameState *state)
+{
+  int write = SDL_AtomicGet(&(c->write));
+  int read = SDL_AtomicGet(&(c->read));
+  unsigned int slot = (unsigned int)write & (CAPTURE_BUFFERS - 1);
+  SDL_Rect window = {0, 0, c->width, c->height};
+  RenderCache *r = state->render_cache;
+
+  if (state->layout.width != c->width || state->layout.height != c->height) {
+    if (c->mismatched++ == 0)
+      fprintf(stderr, "[error]: the window is now %dx%d pixels, frames not captured until it is %dx%d again\n",
+	      state->layout.width, state->layout.height, c->width, c->height);
+    return;
+  }
+  if ((unsigned int)(write - read) >= CAPTURE_BUFFERS) {
+    c->dropped++;
+    return;
+  }
+  /* the writer is done with this buffer, and its reads have to finish before it is refilled */
+  SDL_MemoryBarrierAcquire();
+  if (r->software) {
+    memcpy(c->buffers[slot], r->software_presented, CAPTURE_FRAME_BYTES(c));
+    c->buffer_argb[slot] = true;
+  } else if (SDL_RenderReadPixels(state->renderer, &window, SDL_PIXELFORMAT_RGBA32, c->buffers[slot],
+				  c->width * 4) == 0) {
+    c->buffer_argb[slot] = false;
+  } else {
+    if (c->dropped++ == 0)
+      fprintf(stderr, "[error]: %s, frame not captured\n", SDL_GetError());
+    return;
+  }
+  c->buffer_counter[slot] = SDL_GetPerformanceCounter();
+  c->captured++;
+  SDL_MemoryBarrierRelease();
+  SDL_AtomicSet(&(c->write), write + 1);
+  SDL_SemPost(c->wake);
+}
+
+/* let the writer finish what was captured, then report and free everything */
+void capture_deinitialize(Capture *c)
+{
+  if (c == NULL)
+    return;
+  SDL_AtomicSet(&(c->running), 0);
+  SDL_SemPost(c->wake);
+  SDL_WaitThread(c->thread, NULL);
+  SDL_DestroySemaphore(c->wake);
+  if (c->raw != NULL && fclose(c->raw) != 0)
+    c->failed++;
+  if (fclose(c->timestamps) != 0)
+    c->failed++;
+  fprintf(stdout, "[info]: capture: %lu frames captured, %lu dropped, %lu the wrong size, %lu written to %s, "
+	  "%lu failed\n", (unsigned long)c->captured, (unsigned long)c->dropped, (unsigned long)c->mismatched,
+	  (unsigned long)c->written, c->directory, (unsigned long)c->failed);
+  arena_destroy(c->arena);
+}
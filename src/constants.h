@@ -6,42 +6,94 @@
 #define WINDOW_HEIGHT_INITIAL 640
 
 /* Framerate constants */
-#define MAX_FPS 30
-#define MS_PER_FRAME 1000 / MAX_FPS
+#define MAX_FPS 30 /* default frame rate, see --fps */
+#define UPDATE_MAX_TICKS_PER_FRAME 8 /* further behind than this, the backlog is dropped */
+
+/* Board constants: the default board, see --board. The batch engine always plays on it */
+#define GRID_COUNT_X 40
+#define GRID_COUNT_Y 30
+#define GRID_CELL_COUNT (GRID_COUNT_X * GRID_COUNT_Y)
+/* Uint64 words in the occupancy bitset of a board of cells cells */
+#define OCCUPANCY_WORDS_FOR(cells) (((cells) + 63) / 64)
+#define OCCUPANCY_WORDS OCCUPANCY_WORDS_FOR(GRID_CELL_COUNT)
+/* --board limits: the starting snake needs a cell in front of it */
+#define BOARD_WIDTH_MIN 5
+#define BOARD_HEIGHT_MIN 1
+#define BOARD_SIZE_MAX 4096
+
+/* a cache line, which data written by different threads is padded apart by */
+#define CACHE_LINE_SIZE 64
+/* alignment of every arena allocation, a cache line */
+#define ARENA_ALIGNMENT CACHE_LINE_SIZE
+
+/* turns buffered ahead of the snake, one is applied per tick; a power of two */
+#define INPUT_QUEUE_SIZE 4
+/* input latency samples kept for percentiles, the most recent ones win */
+#define LATENCY_SAMPLES_MAX 1024
+
+/* frame telemetry, see telemetry.c: samples waiting to be drained (a power of two, drained
+ * at half full), and histogram buckets of TELEMETRY_BUCKET_US each; slower phases land in the
+ * last bucket */
+#define TELEMETRY_RING_SIZE 256
+#define TELEMETRY_BUCKET_US 5
+#define TELEMETRY_BUCKETS 4096
+
+/* frame capture, see capture.c: frames that can wait for the writer thread before new ones are
+ * dropped (a power of two), each a full window of RGBA pixels */
+#define CAPTURE_BUFFERS 8
 
 /* Snake Constants */
 #define SNAKE_MOVE_DELAY_DECREMENT_MS 20
 #define SNAKE_MOVE_DELAY_MIN_MS 50
+/* every game starts out heading this way; the main thread counts on it when it restarts one */
+#define SNAKE_INITIAL_DIRECTION EAST
 
 /* Render constants */
 #define WINDOW_BORDER_THICKNESS 4
 #define WINDOW_BORDER_COLOR 0xaa, 0xaa, 0xaa
 
+/* sizes in window coordinates; the Layout (render.c) scales them to pixels on HiDPI displays */
 #define MENU_HEIGHT 40
 #define MENU_EXIT_BUTTON_COLOR 0xee, 0x00, 0x00
 #define MENU_EXIT_BUTTON_COLOR_HOVER 0xff, 0x66, 0x66
 #define MENU_EXIT_BUTTON_W 40
-#define MENU_EXIT_BUTTON_H MENU_HEIGHT
-#define MENU_EXIT_BUTTON_X (WINDOW_WIDTH_INITIAL - WINDOW_BORDER_THICKNESS - MENU_EXIT_BUTTON_W)
-#define MENU_EXIT_BUTTON_Y WINDOW_BORDER_THICKNESS
 
 #define GRID_COLOR 0x66, 0x66, 0x66
-#define GRID_COUNT_X 40
-#define GRID_COUNT_Y 30
-#define GRID_X WINDOW_BORDER_THICKNESS
-#define GRID_Y (WINDOW_BORDER_THICKNESS + MENU_HEIGHT + WINDOW_BORDER_THICKNESS)
-#define GRID_WIDTH (WINDOW_WIDTH_INITIAL - GRID_X - WINDOW_BORDER_THICKNESS)
-#define GRID_HEIGHT (WINDOW_HEIGHT_INITIAL - GRID_Y - WINDOW_BORDER_THICKNESS)
-#define GRID_CELL_WIDTH ((float)GRID_WIDTH / (float)GRID_COUNT_X)
-#define GRID_CELL_HEIGHT ((float)GRID_HEIGHT / (float)GRID_COUNT_Y)
+/* cells narrower or shorter than this many pixels are drawn edge to edge, without grid lines */
+#define GRID_LINES_MIN_CELL 4
 
 #define SNAKE_COLOR 0xff, 0xff, 0xff
 
 #define OVERLAY_PAUSE_COLOR 0xff, 0xff, 0xff
 #define OVERLAY_DEAD_COLOR 0xff, 0x00, 0x00
+#define OVERLAY_WIN_COLOR 0x00, 0xff, 0x00
 
 #define FOOD_COLOR 0xff, 0x00, 0x00
 
+/* menu text, see text.c: the font's glyph size in font pixels, how many glyphs its atlas holds,
+ * and window coordinates per font pixel. TEXT_FIELDS numbers (score, length, speed, time) are
+ * drawn, each TEXT_FIELD_CHARS characters long with its label */
+#define TEXT_GLYPH_WIDTH 5
+#define TEXT_GLYPH_HEIGHT 7
+#define TEXT_ATLAS_GLYPHS 27
+#define TEXT_ATLAS_WIDTH (TEXT_ATLAS_GLYPHS * (TEXT_GLYPH_WIDTH + 1))
+#define TEXT_SCALE 2
+#define TEXT_FIELDS 4
+#define TEXT_FIELD_CHARS 15
+#define TEXT_COLOR 0xdd, 0xdd, 0xdd
+
+/* telemetry bars in the menu, one row per phase of the last frame */
+#define TELEMETRY_OVERLAY_X (WINDOW_BORDER_THICKNESS + 8)
+#define TELEMETRY_OVERLAY_Y (WINDOW_BORDER_THICKNESS + 4)
+#define TELEMETRY_OVERLAY_BAR_H 6
+#define TELEMETRY_OVERLAY_BAR_GAP 2
+#define TELEMETRY_OVERLAY_W_MAX 300
+#define TELEMETRY_OVERLAY_US_PER_PIXEL 20
+#define TELEMETRY_INPUT_COLOR 0x00, 0xaa, 0xff
+#define TELEMETRY_UPDATE_COLOR 0x00, 0xdd, 0x66
+#define TELEMETRY_RENDER_COLOR 0xff, 0xcc, 0x00
+#define TELEMETRY_PRESENT_COLOR 0xcc, 0x66, 0xff
+
 /* end Render constants */
 
 #endif /* SNAKE_CONSTANTS_H */
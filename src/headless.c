@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "types.h"
+#include "constants.h"
+
+/* a game with no food eaten for this many ticks per cell is a bot going around in circles */
+#define HEADLESS_STARVATION_TICKS_PER_CELL 4
+/* games are handed out to workers in chunks; small enough to balance, big enough to be cheap */
+#define HEADLESS_CHUNK_GAMES 64
+#define HEADLESS_MAX_THREADS 256
+#define HEADLESS_PROGRESS_MS 1000
+
+/* update.c functions */
+bool reset(GameState *state);
+void step(GameState *state, Direction action);
+
+/* snake.c functions */
+size_t snake_arena_size(unsigned int width, unsigned int height);
+Snake * snake_create(Arena *a, unsigned int width, unsigned int height);
+size_t snake_body_size(unsigned int width, unsigned int height);
+
+/* arena.c functions */
+Arena * arena_create(size_t size);
+void arena_destroy(Arena *a);
+
+/* rng.c functions */
+void rng_seed(Rng *r, Uint64 seed, Uint64 stream);
+
+/* policy.c functions */
+Direction policy_greedy(GameState *state);
+Direction policy_autopilot(GameState *state);
+
+/* autopilot.c functions */
+size_t autopilot_arena_size(unsigned int width, unsigned int height);
+Autopilot * autopilot_create(Arena *arena, unsigned int width, unsigned int height);
+void autopilot_merge_stats(AutopilotStats *into, const AutopilotStats *from);
+void autopilot_report(const AutopilotStats *s, const char *label);
+
+/* running totals for one worker; only that worker writes them, guarded by a sequence counter
+ * so the reporting thread can read a consistent copy without a lock */
+typedef struct {
+  Uint64 games;
+  Uint64 ticks;
+  Uint64 score;
+  Uint64 length;
+  Uint64 wins;
+} HeadlessTotals;
+
+typedef struct HeadlessRunner HeadlessRunner;
+
+/* each worker owns a contiguous range of chunks; the padding keeps the claim counter, which
+ * other workers hit when stealing, off the cache line holding the results */
+typedef struct {
+  SDL_atomic_t next_chunk;
+  int end_chunk;
+  char padding_chunks[CACHE_LINE_SIZE];
+  SDL_atomic_t totals_sequence;
+  HeadlessTotals totals;
+  char padding_totals[CACHE_LINE_SIZE];
+  HeadlessRunner *runner;
+  AutopilotStats autopilot_stats; /* written once as the worker exits */
+  SDL_Thread *thread;
+  int id;
+} HeadlessWorker;
+
+struct HeadlessRunner {
+  HeadlessWorker *workers;
+  int worker_count;
+  unsigned long games;
+  bool autopilot;
+  unsigned int width; /* the board every game is played on */
+  unsigned int height;
+  Uint64 seed; /* game g's food comes from stream g, whichever worker plays it */
+  SDL_atomic_t workers_finished;
+};
+
+/* play a single game to the end with the autopilot if the state has one, the greedy policy
+ * otherwise; no window and no clock involved */
+void headless_play_game(GameState *state)
+{
+  Uint64 last_food_tick = 0;
+  Uint64 starvation_ticks = (Uint64)HEADLESS_STARVATION_TICKS_PER_CELL * state->snake->cell_count;
+  unsigned int score = 0;
+
+  while (state->snake->is_alive && !state->snake->has_won) {
+    step(state, state->autopilot != NULL ? policy_autopilot(state) : policy_greedy(state));
+    if (state->score != score) {
+      score = state->score;
+      last_food_tick = state->tick;
+    } else if (state->tick - last_food_tick > starvation_ticks) {
+      break;
+    }
+  }
+}
+
+/* claim the next chunk from a worker's range; returns -1 once the range is used up */
+int _headless_claim_chunk(HeadlessWorker *w)
+{
+  int chunk;
+
+  /* cheap check first so idle thieves don't keep bumping an exhausted counter */
+  if (SDL_AtomicGet(&w->next_chunk) >= w->end_chunk)
+    return -1;
+  chunk = SDL_AtomicAdd(&w->next_chunk, 1);
+  return chunk < w->end_chunk ? chunk : -1;
+}
+
+/* own range first, then steal from the other workers, starting with the next one along */
+int _headless_next_chunk(HeadlessWorker *w)
+{
+  HeadlessRunner *runner = w->runner;
+  int chunk = _headless_claim_chunk(w);
+
+  for (int i = 1; chunk < 0 && i < runner->worker_count; i++)
+    chunk = _headless_claim_chunk(runner->workers + (w->id + i) % runner->worker_count);
+  return chunk;
+}
+
+void _headless_publish(HeadlessWorker *w, GameState *state)
+{
+  SDL_AtomicAdd(&w->totals_sequence, 1); /* odd: write in progress */
+  SDL_MemoryBarrierRelease();
+  w->totals.games++;
+  w->totals.ticks += state->tick;
+  w->totals.score += state->score;
+  w->totals.length += state->snake->length;
+  w->totals.wins += state->snake->has_won;
+  SDL_MemoryBarrierRelease();
+  SDL_AtomicAdd(&w->totals_sequence, 1); /* even: totals are consistent again */
+}
+
+void _headless_read_totals(HeadlessWorker *w, HeadlessTotals *out)
+{
+  int sequence;
+
+  do {
+    sequence = SDL_AtomicGet(&w->totals_sequence);
+    SDL_MemoryBarrierAcquire();
+    *out = w->totals;
+    SDL_MemoryBarrierAcquire();
+  } while ((sequence & 1) || sequence != SDL_AtomicGet(&w->totals_sequence));
+}
+
+int _headless_worker(void *data)
+{
+  HeadlessWorker *w = data;
+  HeadlessRunner *runner = w->runner;
+  unsigned long games = runner->games;
+  GameState state;
+  Arena *arena;
+  int chunk;
+
+  memset(&state, 0, sizeof(state));
+  /* each worker's snake is allocated once and reset in place for every game it plays; a worker
+   * without one leaves its games for the others to steal */
+  arena = arena_create(snake_arena_size(runner->width, runner->height)
+			+ (runner->autopilot ? autopilot_arena_size(runner->width, runner->height) : 0));
+  if (arena != NULL)
+    state.snake = snake_create(arena, runner->width, runner->height);
+  if (state.snake != NULL && runner->autopilot) {
+    state.autopilot = autopilot_create(arena, runner->width, runner->height);
+    if (state.autopilot == NULL)
+      state.snake = NULL;
+  }
+  while (state.snake != NULL && (chunk = _headless_next_chunk(w)) >= 0) {
+    unsigned long first = (unsigned long)chunk * HEADLESS_CHUNK_GAMES;
+    unsigned long last = first + HEADLESS_CHUNK_GAMES < games ? first + HEADLESS_CHUNK_GAMES : games;
+
+    for (unsigned long g = first; g < last; g++) {
+      rng_seed(&(state.rng), runner->seed, g);
+      if (!reset(&state))
+	break;
+      headless_play_game(&state);
+      _headless_publish(w, &state);
+    }
+  }
+  if (state.autopilot != NULL)
+    w->autopilot_stats = state.autopilot->stats;
+  if (arena != NULL)
+    arena_destroy(arena);
+  SDL_AtomicAdd(&runner->workers_finished, 1);
+  return 0;
+}
+
+void _headless_sum_totals(HeadlessRunner *runner, HeadlessTotals *sum)
+{
+  HeadlessTotals t;
+
+  memset(sum, 0, sizeof(*sum));
+  for (int i = 0; i < runner->worker_count; i++) {
+    _headless_read_totals(runner->workers + i, &t);
+    sum->games += t.games;
+    sum->ticks += t.ticks;
+    sum->score += t.score;
+    sum->length += t.length;
+    sum->wins += t.wins;
+  }
+}
+
+void _headless_report(HeadlessTotals *t, double seconds, const char *label)
+{
+  fprintf(stdout, "[info]: %s %llu games, %llu ticks in %.3f s (%.0f games/s, %.0f ticks/s), "
+	  "mean score %.2f, mean length %.2f, mean ticks survived %.1f, %llu won\n",
+	  label, (unsigned long long)t->games, (unsigned long long)t->ticks, seconds,
+	  seconds > 0 ? t->games / seconds : 0.0,
+	  seconds > 0 ? t->ticks / seconds : 0.0,
+	  t->games > 0 ? (double)t->score / t->games : 0.0,
+	  t->games > 0 ? (double)t->length / t->games : 0.0,
+	  t->games > 0 ? (double)t->ticks / t->games : 0.0, (unsigned long long)t->wins);
+}
+
+/* play games on a width x height board across threads worker threads (0 for one per core),
+ * streaming aggregate results once a second while they run; the bots are greedy unless
+ * autopilot is set. Every game has its own random stream of seed, so the totals are the same
+ * for a seed however many threads play it */
+int headless_run(unsigned long games, int threads, bool autopilot, unsigned int width, unsigned int height,
+		 Uint64 seed)
+{
+  HeadlessRunner runner;
+  HeadlessTotals totals;
+  AutopilotStats autopilot_stats;
+  Uint64 start_counter, last_report_ms;
+  int chunks = (int)((games + HEADLESS_CHUNK_GAMES - 1) / HEADLESS_CHUNK_GAMES);
+  int started = 0;
+  double seconds;
+
+  if (threads <= 0)
+    threads = SDL_GetCPUCount();
+  if (threads > HEADLESS_MAX_THREADS)
+    threads = HEADLESS_MAX_THREADS;
+
+  runner.workers = calloc(threads, sizeof(HeadlessWorker));
+  if (runner.workers == NULL) {
+    fprintf(stderr, "[error]: Could not allocate memory for headless workers\n");
+    return -1;
+  }
+  runner.worker_count = threads;
+  runner.games = games;
+  runner.autopilot = autopilot;
+  runner.width = width;
+  runner.height = height;
+  runner.seed = seed;
+  SDL_AtomicSet(&runner.workers_finished, 0);
+
+  /* split the chunks evenly up front; stealing evens out games that end early */
+  for (int i = 0; i < threads; i++) {
+    HeadlessWorker *w = runner.workers + i;
+    SDL_AtomicSet(&w->next_chunk, (int)((long long)chunks * i / threads));
+    w->end_chunk = (int)((long long)chunks * (i + 1) / threads);
+    SDL_AtomicSet(&w->totals_sequence, 0);
+    w->runner = &runner;
+    w->id = i;
+  }
+
+  start_counter = SDL_GetPerformanceCounter();
+  last_report_ms = SDL_GetTicks64();
+  for (int i = 0; i < threads; i++) {
+    runner.workers[i].thread = SDL_CreateThread(_headless_worker, "headless", runner.workers + i);
+    if (runner.workers[i].thread == NULL) {
+      fprintf(stderr, "[error]: %s\n", SDL_GetError());
+      /* the workers already running will steal the missing worker's chunks */
+      SDL_AtomicAdd(&runner.workers_finished, 1);
+      continue;
+    }
+    started++;
+  }
+  if (started == 0) {
+    free(runner.workers);
+    return -1;
+  }
+
+  while (SDL_AtomicGet(&runner.workers_finished) < threads) {
+    SDL_Delay(10);
+    if (SDL_GetTicks64() - last_report_ms >= HEADLESS_PROGRESS_MS) {
+      last_report_ms = SDL_GetTicks64();
+      _headless_sum_totals(&runner, &totals);
+      seconds = (double)(SDL_GetPerformanceCounter() - start_counter) / SDL_GetPerformanceFrequency();
+      _headless_report(&totals, seconds, "progress:");
+    }
+  }
+  for (int i = 0; i < threads; i++)
+    SDL_WaitThread(runner.workers[i].thread, NULL);
+  seconds = (double)(SDL_GetPerformanceCounter() - start_counter) / SDL_GetPerformanceFrequency();
+
+  _headless_sum_totals(&runner, &totals);
+  fprintf(stdout, "[info]: %i threads, %lu bytes per snake, %lu of them its body\n", started,
+	  (unsigned long)snake_arena_size(width, height), (unsigned long)snake_body_size(width, height));
+  _headless_report(&totals, seconds, "done:");
+  if (autopilot) {
+    memset(&autopilot_stats, 0, sizeof(autopilot_stats));
+    for (int i = 0; i < threads; i++)
+      autopilot_merge_stats(&autopilot_stats, &(runner.workers[i].autopilot_stats));
+    autopilot_report(&autopilot_stats, "autopilot");
+  }
+  free(runner.workers);
+  return 0;
+}
@@ -1,13 +1,20 @@
+#include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
 #include "logic.h"
 #include "types.h"
 
-bool is_mouse_over_exit_button(int x, int y)
+/* snake.c functions */
+void snake_iterate(const Snake *s, SnakeIterator *it);
+bool snake_iterate_next(SnakeIterator *it, SnakeSegment *seg);
+
+/* x and y are window coordinates, as mouse events report them */
+bool is_mouse_over_exit_button(const Layout *l, int x, int y)
 {
-  if (x >= MENU_EXIT_BUTTON_X && x < MENU_EXIT_BUTTON_X + MENU_EXIT_BUTTON_W &&
-      y >= MENU_EXIT_BUTTON_Y && y < MENU_EXIT_BUTTON_Y + MENU_EXIT_BUTTON_H)
-    return true;
-  else
-    return false;
+  SDL_Point pixel = {(int)(x * l->scale), (int)(y * l->scale)};
+
+  return SDL_PointInRect(&pixel, &(l->exit_button));
 }
 
 bool is_point_in_array(Point *p, Point *p_arr, unsigned int length)
@@ -18,3 +25,117 @@ bool is_point_in_array(Point *p, Point *p_arr, unsigned int length)
   }
   return false;
 }
+
+/* walks the body segment by segment; is_point_occupied is the constant time lookup */
+bool is_point_in_snake(Point *p, Snake *s)
+{
+  SnakeIterator it;
+  SnakeSegment seg;
+
+  snake_iterate(s, &it);
+  while (snake_iterate_next(&it, &seg)) {
+    if (seg.x == p->x && seg.y == p->y)
+      return true;
+  }
+  return false;
+}
+
+/* constant time lookup in the snake's occupancy bitset. The width is read from the snake on
+ * every call: building the default board's 40 in as a constant here, in point_step and in
+ * snake.c's occupancy helpers made headless runs no faster */
+bool is_point_occupied(Point *p, Snake *s)
+{
+  unsigned int cell = p->y * s->width + p->x;
+  return (s->occupancy[cell / 64] >> (cell % 64)) & 1;
+}
+
+Direction direction_opposite(Direction d)
+{
+  switch (d) {
+  case NORTH: return SOUTH;
+  case SOUTH: return NORTH;
+  case EAST: return WEST;
+  case WEST: return EAST;
+  }
+  return d;
+}
+
+/* the neighbouring cell of p in direction d; returns false if that would leave the width x
+ * height grid */
+bool point_step(Point *p, Direction d, unsigned int width, unsigned int height, Point *out)
+{
+  *out = *p;
+  switch (d) {
+  case NORTH:
+    if (p->y == 0) return false;
+    out->y--;
+    break;
+  case SOUTH:
+    if (p->y + 1 == height) return false;
+    out->y++;
+    break;
+  case EAST:
+    if (p->x + 1 == width) return false;
+    out->x++;
+    break;
+  case WEST:
+    if (p->x == 0) return false;
+    out->x--;
+    break;
+  default:
+    fprintf(stderr, "[error]: unknown enum Direction [%i]\n", d);
+    return false;
+  }
+  return true;
+}
+
+void jitter_record(JitterStats *j, double ms)
+{
+  j->count++;
+  j->sum += ms;
+  j->sum_squares += ms * ms;
+  if (j->count == 1 || ms > j->max)
+    j->max = ms;
+}
+
+void jitter_report(JitterStats *j, const char *label)
+{
+  double mean, variance;
+
+  if (j->count == 0) {
+    fprintf(stdout, "[info]: %s: no samples\n", label);
+    return;
+  }
+  mean = j->sum / j->count;
+  variance = j->sum_squares / j->count - mean * mean;
+  fprintf(stdout, "[info]: %s: %llu samples, mean %.3f ms, stddev %.3f ms, max %.3f ms\n",
+	  label, (unsigned long long)j->count, mean, variance > 0 ? sqrt(variance) : 0.0, j->max);
+}
+
+void latency_record(LatencySamples *l, double ms)
+{
+  l->samples[l->next] = ms;
+  l->next = (l->next + 1) % LATENCY_SAMPLES_MAX;
+  l->count++;
+}
+
+int _compare_doubles(const void *a, const void *b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+void latency_report(LatencySamples *l, const char *label)
+{
+  double sorted[LATENCY_SAMPLES_MAX];
+  unsigned int n = l->count < LATENCY_SAMPLES_MAX ? (unsigned int)l->count : LATENCY_SAMPLES_MAX;
+
+  if (n == 0) {
+    fprintf(stdout, "[info]: %s: no samples\n", label);
+    return;
+  }
+  memcpy(sorted, l->samples, n * sizeof(double));
+  qsort(sorted, n, sizeof(double), _compare_doubles);
+  fprintf(stdout, "[info]: %s: %u samples, p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+	  label, n, sorted[n / 2], sorted[n * 90 / 100], sorted[n * 99 / 100], sorted[n - 1]);
+}
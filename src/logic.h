@@ -5,7 +5,15 @@
 #ifndef SNAKE_LOGIC_H
 #define SNAKE_LOGIC_H
 
-bool is_mouse_over_exit_button(int x, int y);
+bool is_mouse_over_exit_button(const Layout *l, int x, int y);
 bool is_point_in_array(Point *p, Point *p_arr, unsigned int length);
+bool is_point_in_snake(Point *p, Snake *s);
+bool is_point_occupied(Point *p, Snake *s);
+Direction direction_opposite(Direction d);
+bool point_step(Point *p, Direction d, unsigned int width, unsigned int height, Point *out);
+void jitter_record(JitterStats *j, double ms);
+void jitter_report(JitterStats *j, const char *label);
+void latency_record(LatencySamples *l, double ms);
+void latency_report(LatencySamples *l, const char *label);
 
 #endif /* SNAKE_LOGIC_H */
@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <time.h>
 #include <SDL2/SDL.h>
 
@@ -10,95 +11,320 @@
 /* #define DEBUG */
 
 /* snake.c functions */
-Snake * snake_initialize(void);
-void snake_deinitialize(Snake *s);
+size_t snake_arena_size(unsigned int width, unsigned int height);
+Snake * snake_create(Arena *a, unsigned int width, unsigned int height);
+int snake_lookup_bench(unsigned int width, unsigned int height, Uint64 seed);
+
+/* autopilot.c functions */
+size_t autopilot_arena_size(unsigned int width, unsigned int height);
+Autopilot * autopilot_create(Arena *arena, unsigned int width, unsigned int height);
+void autopilot_report(const AutopilotStats *s, const char *label);
+int autopilot_bench(unsigned int width, unsigned int height, unsigned long max_ticks, Uint64 seed);
+
+/* arena.c functions */
+void memory_install_hooks(void);
+unsigned long memory_allocation_count(void);
+Arena * arena_create(size_t size);
+void * arena_alloc(Arena *a, size_t size);
+void arena_destroy(Arena *a);
 
 /* render.c functions */
 /* render function is only responsible for drawing game objects */
-void render(GameState *state);
+bool render(GameState *state, const Snapshot *s);
+size_t render_arena_size(unsigned int width, unsigned int height);
+bool render_initialize(GameState *state, bool software, unsigned int width, unsigned int height);
+void render_deinitialize(GameState *state);
 
 /* process_input.c functions */
 /* process_input is only responsible for setting GameState based on input */
 void process_input(GameState *state);
+void process_input_initialize(GameState *state);
 
 /* update.c functions */
-/* update function is only responsible for handling game logic */
-void update(GameState *state);
+bool reset(GameState *state);
+
+/* rng.c functions */
+void rng_seed(Rng *r, Uint64 seed, Uint64 stream);
+Uint64 rng_clock_seed(void);
+
+/* sim.c functions */
+/* the simulation thread runs update() on its own clock and publishes snapshots for render */
+size_t sim_arena_size(unsigned int width, unsigned int height);
+bool sim_start(GameState *state);
+void sim_stop(GameState *state);
+const Snapshot * sim_acquire_snapshot(GameState *state);
+
+/* telemetry.c functions */
+Telemetry * telemetry_initialize(Arena *a, bool enabled, const char *csv_path);
+void telemetry_frame_begin(Telemetry *t);
+void telemetry_phase_end(Telemetry *t, TelemetryPhase phase);
+void telemetry_frame_end(Telemetry *t);
+unsigned int telemetry_pending(Telemetry *t);
+void telemetry_drain(Telemetry *t);
+void telemetry_report(Telemetry *t);
+void telemetry_deinitialize(Telemetry *t);
+
+/* capture.c functions */
+Capture * capture_initialize(const char *directory, bool raw, int width, int height);
+void capture_frame(Capture *c, GameState *state);
+void capture_deinitialize(Capture *c);
+
+/* replay.c functions */
+size_t replay_arena_size(unsigned int width, unsigned int height);
+ReplayWriter * replay_open(Arena *a, const char *path, unsigned int width, unsigned int height, Uint64 seed,
+			   Uint64 move_delay_ms);
+void replay_close(ReplayWriter *w);
+int replay_play(const char *path, bool seek, Uint64 seek_tick);
 
-GameState * initialize()
+/* share.c functions */
+size_t share_arena_size(void);
+Share * share_open(Arena *a, const char *name, GameState *state);
+void share_close(Share *share);
+int share_bot(const char *name, unsigned long max_commands);
+
+/* headless.c functions */
+int headless_run(unsigned long games, int threads, bool autopilot, unsigned int width, unsigned int height,
+		 Uint64 seed);
+
+/* batch.c functions */
+int batch_run(unsigned int count, unsigned long ticks, Uint64 seed);
+
+/* swarm.c functions */
+int swarm_run(unsigned int count, unsigned long ticks, int threads, Uint64 seed);
+
+/* open the window and its renderer, an accelerated one unless software is set or there is none
+ * and the backend allows falling back, in which case software is set */
+bool _initialize_window(GameState *state, Options *options, bool *software)
 {
-  GameState *state = NULL;
   SDL_Window *window = NULL;
   SDL_Renderer *renderer = NULL;
-  Snake *snake = NULL;
-  
-  /* allocate space for our GameState struct, return NULL if malloc fails */
-  state = malloc(sizeof(GameState));
-  if (state == NULL) {
-    fprintf(stderr, "[error]: Could not allocate memory for GameState\n");
-    return NULL;
-  }
+  Uint32 renderer_flags = SDL_RENDERER_ACCELERATED;
 
-  /* initialize SDL subsystems, or print error and return NULL on failure */
-  if (SDL_Init( SDL_INIT_TIMER | SDL_INIT_VIDEO | SDL_INIT_EVENTS ) != 0) {
-    fprintf(stderr, "[error]: %s\n", SDL_GetError());
-    return NULL;
-  }
-  
   /* allocate the SDL window */
   window = SDL_CreateWindow("snake", /* title */
 					SDL_WINDOWPOS_CENTERED, /* window x position */
 					SDL_WINDOWPOS_CENTERED, /* window y position */
 					WINDOW_WIDTH_INITIAL, /* window width */
 					WINDOW_HEIGHT_INITIAL, /* window height */
-					SDL_WINDOW_SHOWN | SDL_WINDOW_BORDERLESS); /* window flags */
-  /* print error and return NULL if SDL_CreateWindow fails */
+					SDL_WINDOW_SHOWN | SDL_WINDOW_BORDERLESS | SDL_WINDOW_RESIZABLE
+					| SDL_WINDOW_ALLOW_HIGHDPI); /* window flags */
+  /* print error and return false if SDL_CreateWindow fails */
   if (window == NULL) {
     fprintf(stderr, "[error]: %s\n", SDL_GetError());
-    return NULL;
+    return false;
   }
   
-  /* allocate the SDL renderer */
-  renderer = SDL_CreateRenderer(window, /* window utilizing the rendering context */
-				-1,     /* use the first available supported driver */
-				SDL_RENDERER_ACCELERATED); /* SDL_RendererFlags */
-  /* print error and return NULL if SDL_CreateRenderer fails */
-  if (renderer == NULL) {
-    fprintf(stderr, "[error]: %s\n", SDL_GetError());
-    return NULL;
+  /* allocate the SDL renderer; with vsync, presenting paces the frames instead of sleeping */
+  if (options->vsync)
+    renderer_flags |= SDL_RENDERER_PRESENTVSYNC;
+  if (!*software) {
+    renderer = SDL_CreateRenderer(window, /* window utilizing the rendering context */
+				  -1,     /* use the first available supported driver */
+				  renderer_flags); /* SDL_RendererFlags */
+    /* print error and return false if SDL_CreateRenderer fails, unless software can take over */
+    if (renderer == NULL && options->render_backend == RENDER_BACKEND_GPU) {
+      fprintf(stderr, "[error]: %s\n", SDL_GetError());
+      return false;
+    }
+    if (renderer == NULL) {
+      fprintf(stdout, "[info]: no accelerated renderer (%s), rendering in software\n", SDL_GetError());
+      *software = true;
+    }
+  }
+  /* the software backend only needs a renderer to copy one texture a frame to the window */
+  if (*software) {
+    renderer_flags = (renderer_flags & ~SDL_RENDERER_ACCELERATED) | SDL_RENDERER_SOFTWARE;
+    renderer = SDL_CreateRenderer(window, -1, renderer_flags);
+    if (renderer == NULL) {
+      fprintf(stderr, "[error]: %s\n", SDL_GetError());
+      return false;
+    }
   }
 
   /* Set renderer to blend, for pause screen overlay */
   SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
   
-  /* initialize and allocate snake */
-  snake = snake_initialize();
-  if (snake == NULL) {
+  state->window = window;
+  state->renderer = renderer;
+  return true;
+}
+
+GameState * initialize(Options *options)
+{
+  GameState *state = NULL;
+  Arena *arena = NULL;
+  const char *video_driver;
+  bool software = options->render_backend == RENDER_BACKEND_SOFTWARE;
+  unsigned int width = options->board_width, height = options->board_height;
+  
+  /* all of the game's memory comes out of one arena allocated here; games are restarted in
+   * place, so nothing is allocated or freed again until deinitialize, or a window resize */
+  arena = arena_create(sizeof(GameState) + snake_arena_size(width, height) + render_arena_size(width, height)
+		       + sim_arena_size(width, height) + sizeof(Telemetry) + 2 * ARENA_ALIGNMENT
+		       + (options->autopilot ? autopilot_arena_size(width, height) : 0)
+		       + (options->record_path != NULL ? replay_arena_size(width, height) : 0)
+		       + (options->share_name != NULL ? share_arena_size() : 0));
+  if (arena == NULL)
+    return NULL;
+  /* space for our GameState struct, return NULL if the arena is too small */
+  state = arena_alloc(arena, sizeof(GameState));
+  if (state == NULL) {
+    fprintf(stderr, "[error]: Could not allocate memory for GameState\n");
+    return NULL;
+  }
+  state->arena = arena;
+  state->options = *options;
+  state->telemetry = telemetry_initialize(arena, options->telemetry, options->telemetry_csv);
+  if (state->telemetry == NULL)
+    return NULL;
+  state->snake = snake_create(arena, width, height);
+  if (state->snake == NULL)
+    return NULL;
+  if (options->autopilot) {
+    state->autopilot = autopilot_create(arena, width, height);
+    if (state->autopilot == NULL)
+      return NULL;
+  }
+
+  /* the food's own generator, so the same seed places the same food */
+  rng_seed(&(state->rng), options->seed, 0);
+
+  /* set up the snake for the first game, and place the first food */
+  if (!reset(state)) {
     fprintf(stderr, "[error]: Failed to initialize snake in snake.c:snake_initialize()\n");
     return NULL;
   }
+  /* turns are checked against the first game before its first snapshot is out */
+  state->turn_game = state->games;
+  state->turn_last = state->snake->direction;
+  /* the replay starts from the same seed, so it places the same first food */
+  if (options->record_path != NULL) {
+    state->replay = replay_open(arena, options->record_path, width, height, options->seed,
+				options->move_delay_ms);
+    if (state->replay == NULL)
+      return NULL;
+  }
+  /* bots see the first game before it starts */
+  if (options->share_name != NULL) {
+    state->share = share_open(arena, options->share_name, state);
+    if (state->share == NULL)
+      return NULL;
+  }
 
-  /* initialize rand() function for randomizing food location */
-  srand(time(NULL));
-  
-  /* don't forget to initialize the GameState struct! */
-  state->window = window;
-  state->renderer = renderer;
   state->is_running = true;
   state->is_paused = false;
-  state->score = 0;
-  state->snake = snake;
-  state->food.x = 0, state->food.y = 0;
+
+  /* initialize SDL subsystems, or print error and return NULL on failure */
+  if (SDL_Init( SDL_INIT_TIMER | SDL_INIT_VIDEO | SDL_INIT_EVENTS ) != 0) {
+    fprintf(stderr, "[error]: %s\n", SDL_GetError());
+    return NULL;
+  }
+  
+  /* SDL's dummy driver has nothing to show a window on: draw in software, into memory only */
+  video_driver = SDL_GetCurrentVideoDriver();
+  if (video_driver != NULL && strcmp(video_driver, "dummy") == 0) {
+    if (options->render_backend == RENDER_BACKEND_GPU) {
+      fprintf(stderr, "[error]: no GPU rendering with the dummy video driver\n");
+      return NULL;
+    }
+    fprintf(stdout, "[info]: dummy video driver, rendering in software without a window\n");
+    software = true;
+  } else if (!_initialize_window(state, options, &software)) {
+    return NULL;
+  }
+
+  if (!render_initialize(state, software, width, height))
+    return NULL;
+  /* every captured frame is the same size, so the window keeps its size while recording */
+  if (options->capture_directory != NULL) {
+    state->capture = capture_initialize(options->capture_directory, options->capture_raw,
+					state->layout.width, state->layout.height);
+    if (state->capture == NULL)
+      return NULL;
+    if (state->window != NULL)
+      SDL_SetWindowResizable(state->window, SDL_FALSE);
+  }
+  process_input_initialize(state);
+  /* give the player one extra move delay before the first move */
+  state->tick_accumulator = -(Sint64)(state->snake->move_delay_ms * SDL_GetPerformanceFrequency() / 1000);
+  if (!sim_start(state))
+    return NULL;
   
   return state;
 }
 
+/* SDL_Delay only has millisecond resolution and tends to oversleep, so sleep until about a
+ * millisecond before the deadline and spin for the rest */
+void _loop_wait_until(Uint64 deadline)
+{
+  Uint64 now, remaining_ms;
+
+  while ((now = SDL_GetPerformanceCounter()) < deadline) {
+    remaining_ms = (deadline - now) * 1000 / SDL_GetPerformanceFrequency();
+    if (remaining_ms > 1)
+      SDL_Delay((Uint32)(remaining_ms - 1));
+  }
+}
+
+/* what the game shown by snapshot s is doing, for the loop's activity accounting */
+ActivityState _loop_activity_state(const Snapshot *s)
+{
+  if (!s->is_alive || s->has_won)
+    return ACTIVITY_OVER;
+  if (s->is_paused)
+    return ACTIVITY_PAUSED;
+  return ACTIVITY_PLAYING;
+}
+
+/* charge the wall and process CPU time since the marks to activity as one wake-up */
+void _loop_activity_record(GameState *state, ActivityState activity, Uint64 *counter_mark, clock_t *cpu_mark)
+{
+  LoopActivity *a = state->loop_activity + activity;
+  Uint64 counter = SDL_GetPerformanceCounter();
+  clock_t cpu = clock();
+
+  a->seconds += (double)(counter - *counter_mark) / SDL_GetPerformanceFrequency();
+  a->cpu_seconds += (double)(cpu - *cpu_mark) / CLOCKS_PER_SEC;
+  a->wakeups++;
+  *counter_mark = counter;
+  *cpu_mark = cpu;
+}
+
+/* CPU time includes the simulation and capture threads, so it is the whole process's */
+void _loop_activity_report(GameState *state)
+{
+  const char *labels[ACTIVITY_STATES] = {"playing", "paused", "dead"};
+  LoopActivity *a;
+
+  for (int i = 0; i < ACTIVITY_STATES; i++) {
+    a = state->loop_activity + i;
+    if (a->seconds <= 0)
+      continue;
+    fprintf(stdout, "[info]: loop while %s: %.1f s, %lu wakeups (%.1f/s), %.1f%% process CPU\n",
+	    labels[i], a->seconds, (unsigned long)a->wakeups, a->wakeups / a->seconds,
+	    100.0 * a->cpu_seconds / a->seconds);
+  }
+}
+
 /* main game loop */
-/* handles user input, updates game objects, and renders to the window */
-/* loop function also responsible for capping FPS */
+/* handles user input and renders to the window; the game itself is updated on the simulation
+ * thread, and each frame draws its latest snapshot */
+/* loop function also responsible for capping FPS; frames are paced against absolute deadlines
+ * on the performance counter. Between frames it sleeps in SDL_WaitEvent until an input event
+ * or the simulation's snapshot event arrives, so a paused or finished game costs no CPU; the
+ * telemetry bars change every frame, so while they are shown it keeps drawing at the frame rate */
 void loop(GameState *state)
 {
-  Uint64 frame_start_time_ms, delta_time_ms;
+  Uint64 frequency = SDL_GetPerformanceFrequency();
+  Uint64 frame_length = state->options.frame_rate > 0 ? frequency / state->options.frame_rate : 0;
+  Uint64 frame_start, previous_frame_start, next_frame;
+  Uint64 drain_time_ms = SDL_GetTicks64();
+  const Snapshot *snapshot;
+  bool presented, wait_for_event, waited = false;
+  bool can_wait = state->snapshot_event != (Uint32)-1;
+  ActivityState activity;
+  Uint64 activity_mark = SDL_GetPerformanceCounter();
+  clock_t cpu_mark = clock();
 
   #ifdef DEBUG
   Uint64 second_start_time_ms;
@@ -106,19 +332,65 @@ void loop(GameState *state)
   second_start_time_ms = SDL_GetTicks64();
   #endif /* #ifdef DEBUG */
 
-  while (state->is_running) {
-    frame_start_time_ms = SDL_GetTicks64();
+  previous_frame_start = SDL_GetPerformanceCounter();
+  next_frame = previous_frame_start + frame_length;
+  while (state->is_running && SDL_AtomicGet(&(state->sim_running))) {
+    frame_start = SDL_GetPerformanceCounter();
     #ifdef DEBUG 
     ++frame_counter;
     #endif
+    /* an interval that slept on events has no frame rate to keep */
+    if (frame_length > 0 && frame_start != previous_frame_start && !waited)
+      jitter_record(&(state->frame_jitter),
+		    ((double)(frame_start - previous_frame_start) - (double)frame_length) * 1000.0 / frequency);
     
+    telemetry_frame_begin(state->telemetry);
     process_input(state);
-    update(state);
-    render(state);
+    telemetry_phase_end(state->telemetry, TELEMETRY_INPUT);
+    /* the update phase is only picking up the simulation's newest snapshot */
+    snapshot = sim_acquire_snapshot(state);
+    activity = _loop_activity_state(snapshot);
+    telemetry_phase_end(state->telemetry, TELEMETRY_UPDATE);
+    presented = render(state, snapshot);
+    /* the frame has to be read back before presenting, which leaves the back buffer undefined */
+    if (presented && state->capture != NULL)
+      capture_frame(state->capture, state);
+    if (state->options.render_delay_ms > 0)
+      SDL_Delay(state->options.render_delay_ms);
+    telemetry_phase_end(state->telemetry, TELEMETRY_RENDER);
+    /* swap the buffers; without a window the frame stays in the software backend's memory */
+    if (presented && state->renderer != NULL)
+      SDL_RenderPresent(state->renderer);
+    telemetry_phase_end(state->telemetry, TELEMETRY_PRESENT);
+    telemetry_frame_end(state->telemetry);
+    previous_frame_start = frame_start;
 
-    delta_time_ms = SDL_GetTicks64() - frame_start_time_ms;
-    if (delta_time_ms < MS_PER_FRAME)
-      SDL_Delay(MS_PER_FRAME - delta_time_ms);
+    /* fold telemetry samples into the histograms (and the CSV file) once a second, or sooner
+     * once the ring is half full, so uncapped frame rates don't overflow it */
+    if (telemetry_pending(state->telemetry) >= TELEMETRY_RING_SIZE / 2
+	|| SDL_GetTicks64() - drain_time_ms >= 1000) {
+      telemetry_drain(state->telemetry);
+      drain_time_ms = SDL_GetTicks64();
+    }
+
+    wait_for_event = can_wait && !state->telemetry->enabled && state->is_running;
+    /* with vsync a presented frame has already waited for the display, and when nothing was
+     * presented there is no frame to pace before sleeping on events */
+    if (frame_length > 0 && !(state->options.vsync && presented) && (presented || !wait_for_event)) {
+      _loop_wait_until(next_frame);
+      next_frame += frame_length;
+      /* a frame overran its slot, or the loop slept on events; start counting again from now
+       * rather than rushing to catch up */
+      if (next_frame < SDL_GetPerformanceCounter())
+	next_frame = SDL_GetPerformanceCounter() + frame_length;
+    }
+    /* nothing can change on screen until an event comes in; SDL_WaitEvent(NULL) leaves it queued */
+    if (wait_for_event && SDL_WaitEvent(NULL) == 0) {
+      fprintf(stderr, "[error]: %s, the game loop will poll\n", SDL_GetError());
+      can_wait = false;
+    }
+    waited = wait_for_event;
+    _loop_activity_record(state, activity, &activity_mark, &cpu_mark);
 
     #ifdef DEBUG
     if (SDL_GetTicks64() - second_start_time_ms >= 1000) {
@@ -134,12 +406,20 @@ void loop(GameState *state)
 /* IMPORTANT: we cannot use the function name 'shutdown', as libX11/libxcb utilize this name */
 int deinitialize(GameState *state)
 {
-  SDL_DestroyRenderer(state->renderer);
-  SDL_DestroyWindow(state->window);
+  sim_stop(state);
+  replay_close(state->replay);
+  share_close(state->share);
+  capture_deinitialize(state->capture);
+  render_deinitialize(state);
+  if (state->renderer != NULL)
+    SDL_DestroyRenderer(state->renderer);
+  if (state->window != NULL)
+    SDL_DestroyWindow(state->window);
   SDL_Quit();
 
-  snake_deinitialize(state->snake);
-  free(state);
+  telemetry_deinitialize(state->telemetry);
+  /* the snake, caches and the GameState itself all live in the arena */
+  arena_destroy(state->arena);
   
   return 0;
 }
@@ -147,18 +427,215 @@ int deinitialize(GameState *state)
 int main(int argc, char *argv[])
 {
   GameState *state = NULL;
+  unsigned long startup_allocations, loop_allocations;
+  Options options = {
+    .frame_rate = MAX_FPS,
+    .vsync = false,
+    .report_timing = false,
+    .move_delay_ms = 0,
+    .telemetry = false,
+    .telemetry_csv = NULL,
+    .render_delay_ms = 0,
+    .autopilot = false,
+    .render_backend = RENDER_BACKEND_AUTO,
+    .capture_directory = NULL,
+    .capture_raw = false,
+    .board_width = GRID_COUNT_X,
+    .board_height = GRID_COUNT_Y,
+    .seed = 0
+  };
+  bool headless = false;
+  unsigned long headless_games = 1;
+  int headless_threads = 0;
+  unsigned int batch_games = 0;
+  unsigned long batch_ticks = 1000;
+  bool ticks_given = false;
+  unsigned int swarm_snakes = 0;
+  unsigned int bench_width = 0, bench_height = 0;
+  bool lookup_bench = false;
+  bool seed_given = false;
+  const char *replay_path = NULL;
+  const char *bot_name = NULL;
+  bool seek = false;
+  Uint64 seek_tick = 0;
+
+  /* --headless [games]: play games with the built-in bot and no window, then exit */
+  /* --threads n: number of worker threads for --headless, 0 (the default) for one per core */
+  /* --batch games [--ticks n]: step that many games in lockstep with the batch engine */
+  /* --swarm snakes [--ticks n] [--threads n]: that many bots sharing one board, arena mode */
+  /* --fps n: frame rate, 0 for uncapped; --vsync: pace frames with the display instead */
+  /* --move-ms n: time per move at the start of a game, the game's tick rate */
+  /* --timing: print tick and frame timing jitter, and input latency percentiles, on exit */
+  /* --telemetry [file.csv]: time each phase of every frame, optionally writing the samples to a
+   * CSV file; F3 toggles it in game */
+  /* --slow-render ms: stall every frame that long, to see that ticks keep time regardless */
+  /* --renderer auto|gpu|software: how the window is drawn; auto uses an accelerated renderer and
+   * falls back to the built-in software rasterizer when there is none */
+  /* --capture directory [--capture-raw]: save every presented frame there, as numbered PNG
+   * files or one raw RGBA stream; frames the writer can't keep up with are dropped */
+  /* --board width height: play on a board of that many cells, in the window or for --headless */
+  /* --seed n: where the food goes, in every mode; the same seed repeats a run */
+  /* --record file: record the game into a replay file */
+  /* --replay file [--seek tick]: play a replay back without a window, to the end or to a tick */
+  /* --share name: publish the game into shared memory every tick, and take bot commands */
+  /* --bot name [--ticks n]: the stand-in bot, steering a game started with --share name */
+  /* --autopilot: the built-in solver plays, in the window or for --headless */
+  /* --autopilot-bench width height [--ticks n]: one autopilot game on a board of any size,
+   * reporting the time per decision */
+  /* --lookup-bench [--board width height]: time collision and free cell lookups at several
+   * snake lengths */
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--headless") == 0) {
+      headless = true;
+      if (i + 1 < argc && argv[i + 1][0] != '-')
+	headless_games = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      headless_threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+      batch_games = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--swarm") == 0 && i + 1 < argc) {
+      swarm_snakes = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+      batch_ticks = strtoul(argv[++i], NULL, 10);
+      ticks_given = true;
+    } else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+      options.frame_rate = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--vsync") == 0) {
+      options.vsync = true;
+    } else if (strcmp(argv[i], "--move-ms") == 0 && i + 1 < argc) {
+      options.move_delay_ms = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--timing") == 0) {
+      options.report_timing = true;
+    } else if (strcmp(argv[i], "--telemetry") == 0) {
+      options.telemetry = true;
+      if (i + 1 < argc && argv[i + 1][0] != '-')
+	options.telemetry_csv = argv[++i];
+    } else if (strcmp(argv[i], "--slow-render") == 0 && i + 1 < argc) {
+      options.render_delay_ms = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--renderer") == 0 && i + 1 < argc && strcmp(argv[i + 1], "auto") == 0) {
+      options.render_backend = RENDER_BACKEND_AUTO;
+      i++;
+    } else if (strcmp(argv[i], "--renderer") == 0 && i + 1 < argc && strcmp(argv[i + 1], "gpu") == 0) {
+      options.render_backend = RENDER_BACKEND_GPU;
+      i++;
+    } else if (strcmp(argv[i], "--renderer") == 0 && i + 1 < argc && strcmp(argv[i + 1], "software") == 0) {
+      options.render_backend = RENDER_BACKEND_SOFTWARE;
+      i++;
+    } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+      options.capture_directory = argv[++i];
+    } else if (strcmp(argv[i], "--capture-raw") == 0) {
+      options.capture_raw = true;
+    } else if (strcmp(argv[i], "--board") == 0 && i + 2 < argc) {
+      options.board_width = strtoul(argv[++i], NULL, 10);
+      options.board_height = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      options.seed = strtoull(argv[++i], NULL, 10);
+      seed_given = true;
+    } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+      options.record_path = argv[++i];
+    } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay_path = argv[++i];
+    } else if (strcmp(argv[i], "--seek") == 0 && i + 1 < argc) {
+      seek_tick = strtoull(argv[++i], NULL, 10);
+      seek = true;
+    } else if (strcmp(argv[i], "--share") == 0 && i + 1 < argc) {
+      options.share_name = argv[++i];
+    } else if (strcmp(argv[i], "--bot") == 0 && i + 1 < argc) {
+      bot_name = argv[++i];
+    } else if (strcmp(argv[i], "--autopilot") == 0) {
+      options.autopilot = true;
+    } else if (strcmp(argv[i], "--autopilot-bench") == 0 && i + 2 < argc) {
+      bench_width = strtoul(argv[++i], NULL, 10);
+      bench_height = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--lookup-bench") == 0) {
+      lookup_bench = true;
+    } else {
+      fprintf(stderr, "[error]: unknown argument %s\n", argv[i]);
+      fprintf(stderr, "usage: %s [--fps n] [--vsync] [--move-ms n] [--timing] [--telemetry [file.csv]]\n"
+	      "             [--slow-render ms] [--renderer auto|gpu|software] [--autopilot]\n"
+	      "             [--capture directory [--capture-raw]] [--board width height] [--seed n]\n"
+	      "             [--record file] [--share name]\n"
+	      "       %s --replay file [--seek tick]\n"
+	      "       %s --bot name [--ticks n]\n"
+	      "       %s --headless [games] [--threads n] [--autopilot] [--board width height] [--seed n]\n"
+	      "       %s --batch games [--ticks n] [--seed n]\n"
+	      "       %s --swarm snakes [--ticks n] [--threads n] [--seed n]\n"
+	      "       %s --autopilot-bench width height [--ticks n] [--seed n]\n"
+	      "       %s --lookup-bench [--board width height] [--seed n]\n",
+	      argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (options.board_width < BOARD_WIDTH_MIN || options.board_width > BOARD_SIZE_MAX
+      || options.board_height < BOARD_HEIGHT_MIN || options.board_height > BOARD_SIZE_MAX) {
+    fprintf(stderr, "[error]: the board must be %d to %d cells wide and %d to %d high\n",
+	    BOARD_WIDTH_MIN, BOARD_SIZE_MAX, BOARD_HEIGHT_MIN, BOARD_SIZE_MAX);
+    return EXIT_FAILURE;
+  }
 
-  /* suppress compiler warnings for unused parameters argc and argv */
-  if (argc != 1)
-    fprintf(stdout, "[info]: %s called with %i arguments\n", argv[0], argc -1);
+  /* a replay has its own seed and board */
+  if (replay_path != NULL)
+    return replay_play(replay_path, seek, seek_tick) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  /* the bot plays whatever game it finds; without --ticks until that game exits */
+  if (bot_name != NULL)
+    return share_bot(bot_name, ticks_given ? batch_ticks : 0) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  /* a run without --seed is still repeatable, with the seed it prints */
+  if (!seed_given) {
+    options.seed = rng_clock_seed();
+    fprintf(stdout, "[info]: seed %llu\n", (unsigned long long)options.seed);
+  }
+
+  if (bench_width > 0 && bench_height > 0) {
+    /* without --ticks the game runs until the board is full */
+    return autopilot_bench(bench_width, bench_height, ticks_given ? batch_ticks : 0, options.seed) == 0
+      ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  if (lookup_bench)
+    return snake_lookup_bench(options.board_width, options.board_height, options.seed) == 0
+      ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  if (swarm_snakes > 0)
+    return swarm_run(swarm_snakes, batch_ticks, headless_threads, options.seed) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  if (batch_games > 0)
+    return batch_run(batch_games, batch_ticks, options.seed) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  /* headless games never touch the window, renderer or the shared GameState */
+  if (headless) {
+    return headless_run(headless_games, headless_threads, options.autopilot, options.board_width,
+			options.board_height, options.seed) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
   
+  /* count heap allocations from here on, SDL's included */
+  memory_install_hooks();
+
   /* setup our Window and Renderer */
-  if ((state = initialize()) == NULL) {
+  if ((state = initialize(&options)) == NULL) {
     return EXIT_FAILURE;
   }
   
-  /* the main game loop */
+  /* the main game loop; anything it allocates is reported with --timing */
+  startup_allocations = memory_allocation_count();
   loop(state);
+  loop_allocations = memory_allocation_count() - startup_allocations;
+  /* the simulation thread writes the tick and input statistics, so stop it before reading them */
+  sim_stop(state);
+
+  if (state->options.report_timing) {
+    jitter_report(&(state->tick_jitter), "tick lateness");
+    jitter_report(&(state->frame_jitter), "frame interval error");
+    _loop_activity_report(state);
+    latency_report(&(state->input_latency), "input to move latency");
+    fprintf(stdout, "[info]: %lu heap allocations after startup\n", loop_allocations);
+    if (state->autopilot != NULL)
+      autopilot_report(&(state->autopilot->stats), "autopilot");
+  }
+  if (state->telemetry->frame > 0)
+    telemetry_report(state->telemetry);
   
   /* deallocate resources */
   if (deinitialize(state) != 0) {
@@ -0,0 +1,49 @@
+#include <SDL2/SDL.h>
+
+#include "types.h"
+#include "logic.h"
+
+/* autopilot.c functions */
+Direction autopilot_decide(Autopilot *a, const Uint64 *occupancy, Uint32 head, Uint32 tail,
+			   Uint32 food, unsigned int length, Direction current);
+
+unsigned int _policy_distance(Point *a, Point *b)
+{
+  unsigned int dx = a->x > b->x ? a->x - b->x : b->x - a->x;
+  unsigned int dy = a->y > b->y ? a->y - b->y : b->y - a->y;
+  return dx + dy;
+}
+
+/* greedy bot: take the free neighbouring cell closest to the food, or keep going if boxed in */
+Direction policy_greedy(GameState *state)
+{
+  Snake *s = state->snake;
+  Point head = s->head_position;
+  Point next;
+  Direction best = s->direction;
+  unsigned int best_distance = s->width + s->height;
+
+  for (int d = NORTH; d <= WEST; d++) {
+    if ((Direction)d == direction_opposite(s->direction))
+      continue;
+    if (!point_step(&head, d, s->width, s->height, &next) || is_point_occupied(&next, s))
+      continue;
+    if (_policy_distance(&next, &(state->food)) < best_distance) {
+      best_distance = _policy_distance(&next, &(state->food));
+      best = d;
+    }
+  }
+  return best;
+}
+
+/* the built-in solver (autopilot.c); state->autopilot must have been created for the game's board */
+Direction policy_autopilot(GameState *state)
+{
+  Snake *s = state->snake;
+  SnakeSegment head = s->head_position;
+  SnakeSegment tail = s->tail_position;
+
+  return autopilot_decide(state->autopilot, s->occupancy, head.y * s->width + head.x,
+			  tail.y * s->width + tail.x, state->food.y * s->width + state->food.x,
+			  s->length, s->direction);
+}
@@ -2,7 +2,64 @@
 #include "types.h"
 #include "logic.h"
 
-void _process_keydown_event(GameState *state, SDL_Keycode sym)
+/* events pulled off SDL's queue per SDL_PeepEvents call */
+#define PROCESS_INPUT_EVENT_BATCH 32
+
+/* render.c functions */
+void render_invalidate(GameState *state);
+bool render_resize(GameState *state);
+
+/* telemetry.c functions */
+void telemetry_toggle(Telemetry *t);
+
+/* sim.c functions */
+const Snapshot * sim_current_snapshot(GameState *state);
+void sim_press_pause(GameState *state);
+
+/* queue a turn for a later tick; it is checked against the last turn queued in this game rather
+ * than the current direction, which the snapshot may not show yet, so two quick presses like
+ * up then left within one move both count. step() still refuses a reversal of the live
+ * direction. This is the producer end of the turn ring the simulation thread consumes */
+void _process_queue_turn(GameState *state, Direction d, Uint32 timestamp_ms)
+{
+  int write = SDL_AtomicGet(&(state->turn_write));
+  int read = SDL_AtomicGet(&(state->turn_read));
+  const Snapshot *snapshot = sim_current_snapshot(state);
+  Turn *turn;
+
+  /* a game restarted some other way than _process_press_pause starts from its own direction */
+  if (snapshot->game > state->turn_game) {
+    state->turn_game = snapshot->game;
+    state->turn_last = snapshot->direction;
+  }
+  if (d == state->turn_last || d == direction_opposite(state->turn_last))
+    return;
+  /* a full queue is a player mashing keys faster than the snake can move; drop the newest */
+  if ((unsigned int)(write - read) >= INPUT_QUEUE_SIZE)
+    return;
+  turn = state->turns + ((unsigned int)write & (INPUT_QUEUE_SIZE - 1));
+  turn->direction = d;
+  turn->timestamp_ms = timestamp_ms;
+  SDL_MemoryBarrierRelease();
+  SDL_AtomicSet(&(state->turn_write), write + 1);
+  state->turn_last = d;
+}
+
+/* P / Space. On a finished game it is a restart: the turns queued so far are dropped with the
+ * old game, and the ones pressed from now on, even in the same frame, are the new game's */
+void _process_press_pause(GameState *state)
+{
+  const Snapshot *snapshot = sim_current_snapshot(state);
+
+  if (!snapshot->is_alive || snapshot->has_won) {
+    SDL_AtomicSet(&(state->turn_restart), SDL_AtomicGet(&(state->turn_write)));
+    state->turn_game = snapshot->game + 1;
+    state->turn_last = SNAKE_INITIAL_DIRECTION;
+  }
+  sim_press_pause(state);
+}
+
+void _process_keydown_event(GameState *state, SDL_Keycode sym, Uint32 timestamp_ms)
 {
   switch (sym) {
   case SDLK_q:
@@ -11,49 +68,106 @@ void _process_keydown_event(GameState *state, SDL_Keycode sym)
     break;
   case SDLK_p:
   case SDLK_SPACE:
-    if (state->snake->is_alive == false)
-      state->snake->should_reset = true;
-    else
-      state->is_paused = !state->is_paused;
+    /* the simulation thread decides between restarting and pausing, from the live game */
+    _process_press_pause(state);
+    break;
+  case SDLK_F3:
+    telemetry_toggle(state->telemetry);
     break;
   case SDLK_UP:
-    if (state->snake->direction != SOUTH)
-      state->snake->direction_queued = NORTH;
+    _process_queue_turn(state, NORTH, timestamp_ms);
     break;
   case SDLK_DOWN:
-    if (state->snake->direction != NORTH)
-      state->snake->direction_queued = SOUTH;
+    _process_queue_turn(state, SOUTH, timestamp_ms);
     break;
   case SDLK_LEFT:
-    if (state->snake->direction != EAST)
-      state->snake->direction_queued = WEST;
+    _process_queue_turn(state, WEST, timestamp_ms);
     break;
   case SDLK_RIGHT:
-    if (state->snake->direction != WEST)
-      state->snake->direction_queued = EAST;
+    _process_queue_turn(state, EAST, timestamp_ms);
     break;
   }
 }
 
+/* runs as SDL queues each event: mouse motion only matters for the exit button hover, so it is
+ * folded into a flag here, and only reaches the queue to wake the game loop when the flag flips */
+int _process_event_filter(void *userdata, SDL_Event *e)
+{
+  GameState *state = userdata;
+  bool hover;
+
+  switch (e->type) {
+  case SDL_MOUSEMOTION:
+    hover = is_mouse_over_exit_button(&(state->layout), e->motion.x, e->motion.y);
+    if (hover == state->exit_button_hover)
+      return 0;
+    state->exit_button_hover = hover;
+    return 1;
+  case SDL_WINDOWEVENT:
+    if (e->window.event == SDL_WINDOWEVENT_LEAVE)
+      state->exit_button_hover = false;
+    return 1;
+  case SDL_KEYDOWN:
+    /* held keys only repeat a direction that is already queued */
+    return e->key.repeat == 0;
+  default:
+    return 1;
+  }
+}
+
+/* install the event filter and stop SDL generating events the game never reads */
+void process_input_initialize(GameState *state)
+{
+  SDL_EventState(SDL_KEYUP, SDL_IGNORE);
+  SDL_EventState(SDL_TEXTINPUT, SDL_IGNORE);
+  SDL_EventState(SDL_TEXTEDITING, SDL_IGNORE);
+  SDL_EventState(SDL_MOUSEBUTTONDOWN, SDL_IGNORE);
+  SDL_EventState(SDL_MOUSEWHEEL, SDL_IGNORE);
+  SDL_SetEventFilter(_process_event_filter, state);
+}
+
+void _process_event(GameState *state, SDL_Event *e)
+{
+  switch (e->type) {
+  case SDL_QUIT:
+    state->is_running = false;
+    break;
+  /* handle MOUSEBUTTONUP event */
+  case SDL_MOUSEBUTTONUP:
+    if (e->button.button == SDL_BUTTON_LEFT && is_mouse_over_exit_button(&(state->layout), e->button.x, e->button.y))
+      state->is_running = false;
+    break;
+  /* the driver lost the contents of render target textures */
+  case SDL_RENDER_TARGETS_RESET:
+    render_invalidate(state);
+    break;
+  /* frames are only presented when something changes, so repaint when the window is uncovered;
+   * a new size, in window coordinates or in pixels, lays everything out again */
+  case SDL_WINDOWEVENT:
+    if (e->window.event == SDL_WINDOWEVENT_EXPOSED)
+      render_invalidate(state);
+    if (e->window.event == SDL_WINDOWEVENT_SIZE_CHANGED && !render_resize(state))
+      state->is_running = false;
+    break;
+  /* handle KEYDOWN events */
+  case SDL_KEYDOWN:
+    _process_keydown_event(state, e->key.keysym.sym, e->key.timestamp);
+  default:
+    break;
+  } /* END switch(e->type) */
+}
+
 /* process_input function is only responsible for handling user input */
 void process_input(GameState *state)
 {
-  SDL_Event e;
-  while (SDL_PollEvent(&e)) {
-    switch (e.type) {
-    case SDL_QUIT:
-      state->is_running = false;
-      break;
-    /* handle MOUSEBUTTONUP event */
-    case SDL_MOUSEBUTTONUP:
-      if (e.button.button == SDL_BUTTON_LEFT && is_mouse_over_exit_button(e.button.x, e.button.y))
-	state->is_running = false;
-      break;
-    /* handle KEYDOWN events */
-    case SDL_KEYDOWN:
-      _process_keydown_event(state, e.key.keysym.sym);
-    default:
-      break;
-    } /* END switch(e.type) */
-  } /* END while (SDL_PollEvent(&e)) */
+  SDL_Event events[PROCESS_INPUT_EVENT_BATCH];
+  int count;
+
+  /* drain the queue in batches rather than one SDL_PollEvent call per event */
+  SDL_PumpEvents();
+  do {
+    count = SDL_PeepEvents(events, PROCESS_INPUT_EVENT_BATCH, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
+    for (int i = 0; i < count; i++)
+      _process_event(state, events + i);
+  } while (count == PROCESS_INPUT_EVENT_BATCH);
 }
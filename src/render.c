@@ -1,34 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <SDL2/SDL.h>
 #include "types.h"
 #include "constants.h"
 #include "logic.h"
 
+/* cells filled per driver submission; bigger boards are submitted in several */
+#define RENDER_CELL_BATCH 4096
+
+/* arena.c functions */
+void * arena_alloc(Arena *a, size_t size);
+
+/* render_software.c functions */
+bool render_software_initialize(GameState *state, RenderCache *c);
+void render_software_deinitialize(RenderCache *c);
+void render_software_static_layer(RenderCache *c, const Layout *l);
+void render_software_fill_rects(RenderCache *c, Uint32 *pixels, const SDL_Rect *rects, int count, Uint32 color);
+void render_software_blend_rect(RenderCache *c, Uint32 *pixels, SDL_Rect rect, Uint32 color, Uint8 alpha);
+Uint32 render_software_color(Uint8 r, Uint8 g, Uint8 b);
+void render_software_copy(RenderCache *c, Uint32 *to, const Uint32 *from);
+void render_software_present(GameState *state, const Uint32 *pixels);
+void render_software_text(RenderCache *c, Uint32 *pixels, bool all);
+
+/* text.c functions */
+void text_initialize(TextCache *t, SDL_Renderer *r);
+void text_deinitialize(TextCache *t);
+void text_layout(TextCache *t, const Layout *l);
+bool text_update(TextCache *t, const Snapshot *s);
+int text_indices(TextCache *t, bool all);
+void text_drawn(TextCache *t);
+
 /* internal function that handles drawing the window border and X button */
-void _render_window_border(SDL_Renderer *r)
+void _render_window_border(SDL_Renderer *r, const Layout *l)
 {
   SDL_Rect border_left = {
     .x = 0,
     .y = 0,
-    .h = WINDOW_HEIGHT_INITIAL,
-    .w = WINDOW_BORDER_THICKNESS
+    .h = l->height,
+    .w = l->border
   };
   SDL_Rect border_right = {
-    .x = WINDOW_WIDTH_INITIAL - WINDOW_BORDER_THICKNESS,
+    .x = l->width - l->border,
     .y = 0,
-    .h = WINDOW_HEIGHT_INITIAL,
-    .w = WINDOW_BORDER_THICKNESS
+    .h = l->height,
+    .w = l->border
   };
   SDL_Rect border_top = {
     .x = 0,
     .y = 0,
-    .h = WINDOW_BORDER_THICKNESS,
-    .w = WINDOW_WIDTH_INITIAL
+    .h = l->border,
+    .w = l->width
   };
   SDL_Rect border_bottom = {
     .x = 0,
-    .y = WINDOW_HEIGHT_INITIAL - WINDOW_BORDER_THICKNESS,
-    .h = WINDOW_BORDER_THICKNESS,
-    .w = WINDOW_WIDTH_INITIAL
+    .y = l->height - l->border,
+    .h = l->border,
+    .w = l->width
   };
   SDL_SetRenderDrawColor(r, WINDOW_BORDER_COLOR, SDL_ALPHA_OPAQUE);
   SDL_RenderFillRect(r, &border_left);
@@ -37,138 +65,578 @@ void _render_window_border(SDL_Renderer *r)
   SDL_RenderFillRect(r, &border_bottom);
 }
 
-void _render_window_menu(SDL_Renderer *r)
+void _render_window_menu(SDL_Renderer *r, const Layout *l, bool exit_button_hover)
 {
-  int mouse_x, mouse_y;
   SDL_Rect menu_bottom_border = {
     .x = 0,
-    .y = WINDOW_BORDER_THICKNESS + MENU_HEIGHT,
-    .w = WINDOW_WIDTH_INITIAL,
-    .h = WINDOW_BORDER_THICKNESS
-  };
-  SDL_Rect menu_exit_button = {
-    .x = MENU_EXIT_BUTTON_X,
-    .y = MENU_EXIT_BUTTON_Y,
-    .w = MENU_EXIT_BUTTON_W,
-    .h = MENU_EXIT_BUTTON_H
+    .y = l->menu.y + l->menu.h,
+    .w = l->width,
+    .h = l->border
   };
   SDL_Rect menu_exit_button_border_left = {
-    .x = MENU_EXIT_BUTTON_X - WINDOW_BORDER_THICKNESS,
-    .y = WINDOW_BORDER_THICKNESS,
-    .w = WINDOW_BORDER_THICKNESS,
-    .h = MENU_EXIT_BUTTON_H
+    .x = l->exit_button.x - l->border,
+    .y = l->exit_button.y,
+    .w = l->border,
+    .h = l->exit_button.h
   };
   SDL_SetRenderDrawColor(r, WINDOW_BORDER_COLOR, SDL_ALPHA_OPAQUE);
   SDL_RenderFillRect(r, &menu_bottom_border);
   SDL_RenderFillRect(r, &menu_exit_button_border_left);
-  SDL_GetMouseState(&mouse_x, &mouse_y);
-  if (is_mouse_over_exit_button(mouse_x, mouse_y))
+  if (exit_button_hover)
     SDL_SetRenderDrawColor(r, MENU_EXIT_BUTTON_COLOR_HOVER, SDL_ALPHA_OPAQUE);
   else
     SDL_SetRenderDrawColor(r, MENU_EXIT_BUTTON_COLOR, SDL_ALPHA_OPAQUE);
-  SDL_RenderFillRect(r, &menu_exit_button);
+  SDL_RenderFillRect(r, &l->exit_button);
 }
 
-/* Draws a grid according to GRID_COUNT_X, GRID_COUNT_Y, GRID_CELL_WIDTH, and GRID_CELL_HEIGHT */
-/* important: grid cell width and height should be calculated as a float, and then case to an int
- *   just before drawing line, to ensure no loss of width or height */
-void _render_grid(SDL_Renderer *r)
+/* Draws the grid lines just before each column and row but the first, from the cell tables,
+ * so they always sit where the cells leave a gap for them; tiny cells have no lines */
+void _render_grid(SDL_Renderer *r, RenderCache *c, const Layout *l)
 {
-  unsigned int i;
-  float x1, y1, x2, y2;
-
+  if (!c->grid_lines)
+    return;
   SDL_SetRenderDrawColor(r, GRID_COLOR, SDL_ALPHA_OPAQUE);
 
-  for (i = 1; i < GRID_COUNT_X; i++) {
-    x1 = GRID_X + (i * GRID_CELL_WIDTH);
-    y1 = GRID_Y;
-    x2 = GRID_X + (i * GRID_CELL_WIDTH);
-    y2 = GRID_Y + GRID_HEIGHT;
-    SDL_RenderDrawLine(r, (int)x1, (int)y1, (int)x2, (int)y2);
+  for (unsigned int i = 1; i < c->board_width; i++)
+    SDL_RenderDrawLine(r, c->columns[i].start - 1, l->grid.y, c->columns[i].start - 1, l->grid.y + l->grid.h);
+  for (unsigned int i = 1; i < c->board_height; i++)
+    SDL_RenderDrawLine(r, l->grid.x, c->rows[i].start - 1, l->grid.x + l->grid.w, c->rows[i].start - 1);
+}
+
+/* everything filled on the board goes through here: one draw color, one driver submission */
+void _render_fill_rects(SDL_Renderer *r, const SDL_Rect *rects, int count)
+{
+  if (count > 0)
+    SDL_RenderFillRects(r, rects, count);
+}
+
+/* pixel rect of grid cell (x, y) from the cached tables; it stops short of the grid lines,
+ * which are already in the static layer underneath */
+SDL_Rect _render_cell_rect(RenderCache *c, unsigned int x, unsigned int y)
+{
+  RenderSpan column = c->columns[x], row = c->rows[y];
+  SDL_Rect rect = {
+    .x = column.start,
+    .y = row.start,
+    .w = column.size,
+    .h = row.size
+  };
+  return rect;
+}
+
+/* submit the waiting snake or empty cells, into the software canvas or through the renderer */
+void _render_flush_cells(SDL_Renderer *r, RenderCache *c, bool snake)
+{
+  SDL_Rect *rects = snake ? c->snake_rects : c->empty_rects;
+  int *count = snake ? &c->snake_count : &c->empty_count;
+
+  if (*count == 0)
+    return;
+  if (c->software) {
+    render_software_fill_rects(c, c->software_canvas, rects, *count,
+			       snake ? render_software_color(SNAKE_COLOR) : render_software_color(0, 0, 0));
+  } else {
+    if (snake)
+      SDL_SetRenderDrawColor(r, SNAKE_COLOR, SDL_ALPHA_OPAQUE);
+    else
+      SDL_SetRenderDrawColor(r, 0, 0, 0, 0xff);
+    _render_fill_rects(r, rects, *count);
   }
-  for (i = 1; i < GRID_COUNT_Y; i++) {
-    x1 = GRID_X;
-    y1 = GRID_Y + (i * GRID_CELL_HEIGHT);
-    x2 = GRID_X + GRID_WIDTH;
-    y2 = GRID_Y + (i * GRID_CELL_HEIGHT);
-    SDL_RenderDrawLine(r, (int)x1, (int)y1, (int)x2, (int)y2);    
+  *count = 0;
+}
+
+/* queue cell (x, y) to be filled as snake or as empty board */
+void _render_push_cell(SDL_Renderer *r, RenderCache *c, unsigned int x, unsigned int y, bool snake)
+{
+  if (snake)
+    c->snake_rects[c->snake_count++] = _render_cell_rect(c, x, y);
+  else
+    c->empty_rects[c->empty_count++] = _render_cell_rect(c, x, y);
+  if ((snake ? c->snake_count : c->empty_count) == RENDER_CELL_BATCH)
+    _render_flush_cells(r, c, snake);
+}
+
+/* queue the cells of the set bits of occupancy word word; the cell's column is stepped along
+ * with the bit instead of dividing for every cell */
+void _render_push_word(SDL_Renderer *r, RenderCache *c, unsigned int word, Uint64 bits, bool snake)
+{
+  unsigned int x = word * 64 % c->board_width, y = word * 64 / c->board_width;
+
+  for (; bits != 0; bits >>= 1, x++) {
+    if (x == c->board_width) {
+      x = 0;
+      y++;
+    }
+    if (bits & 1)
+      _render_push_cell(r, c, x, y, snake);
   }
 }
 
-void _render_snake(SDL_Renderer *r, Snake *s)
+/* fill every occupied cell of the snapshot, in batches */
+void _render_snake(SDL_Renderer *r, RenderCache *c, const Snapshot *s)
 {
-  SDL_SetRenderDrawColor(r, SNAKE_COLOR, SDL_ALPHA_OPAQUE);
-  int length = s->length;
-  for (int i = 0; i < length; i++) {
-    SnakeSegment seg = *(s->segments + i);
-    SDL_Rect rect = {
-      .x = (int) ((seg.x * GRID_CELL_WIDTH) + GRID_X),
-      .y = (int) ((seg.y * GRID_CELL_HEIGHT) + GRID_Y),
-      .w = (int) (GRID_CELL_WIDTH + 0.5f), /* round up to the nearest pixel */
-      .h = (int) (GRID_CELL_HEIGHT + 0.5f)
-    };
-    SDL_RenderFillRect(r, &rect);
+  for (unsigned int word = 0; word < c->occupancy_words; word++) {
+    if (s->occupancy[word] != 0)
+      _render_push_word(r, c, word, s->occupancy[word], true);
   }
+  _render_flush_cells(r, c, true);
 }
 
-void _render_food(SDL_Renderer *r, Food f)
+void _render_food(SDL_Renderer *r, RenderCache *c, Food f)
 {
-  SDL_Rect food_rect = {
-    .x = (int) ((f.x * GRID_CELL_WIDTH) + GRID_X),
-    .y = (int) ((f.y * GRID_CELL_HEIGHT) + GRID_Y),
-    .w = (int) GRID_CELL_WIDTH + 0.5f,
-    .h = (int) GRID_CELL_HEIGHT + 0.5f
-  };
+  SDL_Rect food_rect = _render_cell_rect(c, f.x, f.y);
+
+  if (c->software) {
+    render_software_fill_rects(c, c->software_canvas, &food_rect, 1, render_software_color(FOOD_COLOR));
+    return;
+  }
   SDL_SetRenderDrawColor(r, FOOD_COLOR, SDL_ALPHA_OPAQUE);
-  SDL_RenderFillRect(r, &food_rect);
+  _render_fill_rects(r, &food_rect, 1);
+}
+
+/* whether the snapshot's board differs from the one in the canvas */
+bool _render_board_changed(RenderCache *c, const Snapshot *s)
+{
+  bool food_visible = !s->has_won;
+
+  if (food_visible != c->presented_food_visible)
+    return true;
+  if (food_visible && (s->food.x != c->presented_food.x || s->food.y != c->presented_food.y))
+    return true;
+  return memcmp(s->occupancy, c->presented_occupancy, c->occupancy_words * sizeof(Uint64)) != 0;
 }
 
-void _render_pause_overlay(SDL_Renderer *r, bool is_paused)
+/* repaint only the cells that differ from the canvas: the occupancy bits that flipped, plus
+ * old food that vanished, then the new food */
+void _render_changed_cells(SDL_Renderer *r, RenderCache *c, const Snapshot *s)
 {
-  if (is_paused) {
-    SDL_Rect overlay_rect = {
-      .x = GRID_X,
-      .y = GRID_Y,
-      .w = GRID_WIDTH,
-      .h = GRID_HEIGHT
-    };
-    SDL_SetRenderDrawColor(r, OVERLAY_PAUSE_COLOR, 0x80);
-    SDL_RenderFillRect(r, &overlay_rect);
+  unsigned int cell;
+  Uint64 changed;
+
+  for (unsigned int word = 0; word < c->occupancy_words; word++) {
+    changed = s->occupancy[word] ^ c->presented_occupancy[word];
+    if (changed == 0)
+      continue;
+    _render_push_word(r, c, word, changed & s->occupancy[word], true);
+    _render_push_word(r, c, word, changed & ~s->occupancy[word], false);
+  }
+  /* eaten food turned into snake above; food that vanished without that, on a restart or a
+   * won game, is cleared here. Its bit didn't flip, so it isn't queued already */
+  if (c->presented_food_visible) {
+    cell = c->presented_food.y * c->board_width + c->presented_food.x;
+    if (!((s->occupancy[cell / 64] >> (cell % 64)) & 1)
+	&& !((c->presented_occupancy[cell / 64] >> (cell % 64)) & 1))
+      _render_push_cell(r, c, c->presented_food.x, c->presented_food.y, false);
   }
+  _render_flush_cells(r, c, false);
+  _render_flush_cells(r, c, true);
+  if (!s->has_won)
+    _render_food(r, c, s->food);
 }
 
-void _render_snake_dead(SDL_Renderer *r, bool snake_is_alive)
+/* the menu text from the glyph atlas in one draw call: every field on a full repaint, which
+ * starts from a clean menu, otherwise only the fields whose number changed, over their old text */
+void _render_text(SDL_Renderer *r, RenderCache *c, bool all)
 {
-  if (snake_is_alive == false) {
-    SDL_Rect overlay_rect = {
-      .x = GRID_X,
-      .y = GRID_Y,
-      .w = GRID_WIDTH,
-      .h = GRID_HEIGHT
-    };
-    SDL_SetRenderDrawColor(r, OVERLAY_DEAD_COLOR, 0x80);
-    SDL_RenderFillRect(r, &overlay_rect);
+  TextCache *t = &(c->text);
+  SDL_Rect slots[TEXT_FIELDS];
+  int count = 0, indices;
+
+  for (int f = 0; !all && f < TEXT_FIELDS; f++) {
+    if (t->fields[f].dirty)
+      slots[count++] = t->fields[f].slot;
+  }
+  if (c->software) {
+    render_software_fill_rects(c, c->software_canvas, slots, count, render_software_color(0, 0, 0));
+    render_software_text(c, c->software_canvas, all);
+  } else if (t->atlas != NULL) {
+    SDL_SetRenderDrawColor(r, 0, 0, 0, 0xff);
+    _render_fill_rects(r, slots, count);
+    indices = text_indices(t, all);
+    if (indices > 0)
+      SDL_RenderGeometry(r, t->atlas, t->vertices, TEXT_FIELDS * TEXT_FIELD_CHARS * 4, t->indices, indices);
   }
+  text_drawn(t);
 }
 
-/* render function is only responsible for drawing game objects */
-void render(GameState *state)
+/* which translucent overlay covers the grid: 0 none, 1 paused, 2 dead, 3 won */
+int _render_overlay_kind(const Snapshot *s)
 {
-  SDL_Renderer *r = state->renderer;
+  if (s->has_won)
+    return 3;
+  if (s->is_alive == false)
+    return 2;
+  if (s->is_paused)
+    return 1;
+  return 0;
+}
+
+/* the translucent overlay's color for an overlay kind; false for none */
+bool _render_overlay_color(int kind, SDL_Color *color)
+{
+  const Uint8 colors[4][3] = {{0, 0, 0}, {OVERLAY_PAUSE_COLOR}, {OVERLAY_DEAD_COLOR}, {OVERLAY_WIN_COLOR}};
+
+  if (kind < 1 || kind > 3)
+    return false;
+  color->r = colors[kind][0];
+  color->g = colors[kind][1];
+  color->b = colors[kind][2];
+  color->a = 0x80;
+  return true;
+}
+
+/* translucent overlay over the grid while paused, after death, or after filling the board */
+void _render_overlay(SDL_Renderer *r, const Layout *l, int kind)
+{
+  SDL_Color color;
+
+  if (!_render_overlay_color(kind, &color))
+    return;
+  SDL_SetRenderDrawColor(r, color.r, color.g, color.b, color.a);
+  _render_fill_rects(r, &l->grid, 1);
+}
+
+const Uint8 _render_telemetry_colors[TELEMETRY_PHASES][3] = {
+  {TELEMETRY_INPUT_COLOR}, {TELEMETRY_UPDATE_COLOR}, {TELEMETRY_RENDER_COLOR}, {TELEMETRY_PRESENT_COLOR}
+};
+
+/* the bar for one phase of the last telemetry frame, drawn over the menu */
+SDL_Rect _render_telemetry_bar(Telemetry *t, int phase)
+{
+  Uint32 width = t->last.phase_us[phase] / TELEMETRY_OVERLAY_US_PER_PIXEL + 1;
+  SDL_Rect bar = {
+    .x = TELEMETRY_OVERLAY_X,
+    .y = TELEMETRY_OVERLAY_Y + phase * (TELEMETRY_OVERLAY_BAR_H + TELEMETRY_OVERLAY_BAR_GAP),
+    .w = width < TELEMETRY_OVERLAY_W_MAX ? (int)width : TELEMETRY_OVERLAY_W_MAX,
+    .h = TELEMETRY_OVERLAY_BAR_H
+  };
+  return bar;
+}
+
+/* one bar per phase of the last telemetry frame, drawn over the menu */
+void _render_telemetry(SDL_Renderer *r, Telemetry *t)
+{
+  SDL_Rect bar;
+
+  for (int p = 0; p < TELEMETRY_PHASES; p++) {
+    bar = _render_telemetry_bar(t, p);
+    SDL_SetRenderDrawColor(r, _render_telemetry_colors[p][0], _render_telemetry_colors[p][1],
+			   _render_telemetry_colors[p][2], 0xff);
+    _render_fill_rects(r, &bar, 1);
+  }
+}
+
+/* the software backend's version of a frame: the board is patched in software_canvas like the
+ * canvas texture, and the overlays go on a copy of it so the canvas stays clean */
+void _render_software(GameState *state, const Snapshot *s, bool full_repaint, int overlay_kind)
+{
+  RenderCache *c = state->render_cache;
+  Uint32 *frame = c->software_canvas;
+  SDL_Rect rect;
+  SDL_Color color;
+
+  if (c->static_layer_dirty) {
+    render_software_static_layer(c, &(state->layout));
+    c->static_layer_dirty = false;
+  }
+  if (full_repaint) {
+    render_software_copy(c, c->software_canvas, c->software_static);
+    _render_snake(NULL, c, s);
+    if (!s->has_won)
+      _render_food(NULL, c, s->food);
+  } else {
+    _render_changed_cells(NULL, c, s);
+  }
+  _render_text(NULL, c, full_repaint);
+
+  if (overlay_kind != 0 || c->telemetry_presented) {
+    frame = c->software_frame;
+    render_software_copy(c, frame, c->software_canvas);
+    if (_render_overlay_color(overlay_kind, &color))
+      render_software_blend_rect(c, frame, state->layout.grid, render_software_color(color.r, color.g, color.b),
+				 color.a);
+    for (int p = 0; c->telemetry_presented && p < TELEMETRY_PHASES; p++) {
+      rect = _render_telemetry_bar(state->telemetry, p);
+      render_software_fill_rects(c, frame, &rect, 1, render_software_color(_render_telemetry_colors[p][0],
+									      _render_telemetry_colors[p][1],
+									      _render_telemetry_colors[p][2]));
+    }
+  }
+  c->software_presented = frame;
+  render_software_present(state, frame);
+}
+
+/* the border, menu and grid only change when the exit button hover does, so they are drawn
+ * into a texture once and copied to the screen each frame */
+/* target is the texture being drawn into (NULL for the screen), restored after a redraw */
+void _render_static_layer(SDL_Renderer *r, RenderCache *c, const Layout *l, SDL_Texture *target)
+{
+  if (c->static_layer != NULL) {
+    if (c->static_layer_dirty) {
+      SDL_SetRenderTarget(r, c->static_layer);
+      SDL_SetRenderDrawColor(r, 0, 0, 0, 0xff);
+      SDL_RenderClear(r);
+      _render_window_border(r, l);
+      _render_window_menu(r, l, c->exit_button_hover);
+      _render_grid(r, c, l);
+      SDL_SetRenderTarget(r, target);
+      c->static_layer_dirty = false;
+    }
+    SDL_RenderCopy(r, c->static_layer, NULL, NULL);
+    return;
+  }
 
-  /* clear screen to black */
+  /* no render target support, draw it every frame as before */
   SDL_SetRenderDrawColor(r, 0, 0, 0, 0xff);
   SDL_RenderClear(r);
+  _render_window_border(r, l);
+  _render_window_menu(r, l, c->exit_button_hover);
+  _render_grid(r, c, l);
+}
+
+/* mark everything for redrawing, e.g. when the driver has thrown away texture contents or
+ * the window was uncovered */
+void render_invalidate(GameState *state)
+{
+  if (state->render_cache != NULL) {
+    state->render_cache->static_layer_dirty = true;
+    state->render_cache->canvas_dirty = true;
+  }
+}
+
+/* lay the window out for the renderer's output size, which on HiDPI displays is bigger than
+ * the window's own size; the border and menu grow with the scale so they look the same */
+void _render_layout(GameState *state)
+{
+  Layout *l = &(state->layout);
+  int window_w = WINDOW_WIDTH_INITIAL, window_h = WINDOW_HEIGHT_INITIAL;
+  int menu_h, exit_w;
+
+  if (state->window != NULL)
+    SDL_GetWindowSize(state->window, &window_w, &window_h);
+  l->width = window_w;
+  l->height = window_h;
+  if (state->renderer != NULL && SDL_GetRendererOutputSize(state->renderer, &(l->width), &(l->height)) != 0) {
+    l->width = window_w;
+    l->height = window_h;
+  }
+  l->scale = window_w > 0 ? (float)l->width / window_w : 1.0f;
+  l->border = (int)(WINDOW_BORDER_THICKNESS * l->scale + 0.5f);
+  menu_h = (int)(MENU_HEIGHT * l->scale + 0.5f);
+  exit_w = (int)(MENU_EXIT_BUTTON_W * l->scale + 0.5f);
+
+  l->menu.x = l->border;
+  l->menu.y = l->border;
+  l->menu.w = SDL_max(l->width - 2 * l->border, 0);
+  l->menu.h = menu_h;
+  l->exit_button.x = l->width - l->border - exit_w;
+  l->exit_button.y = l->border;
+  l->exit_button.w = exit_w;
+  l->exit_button.h = menu_h;
+  l->grid.x = l->border;
+  l->grid.y = 2 * l->border + menu_h;
+  l->grid.w = SDL_max(l->width - 2 * l->border, 0);
+  l->grid.h = SDL_max(l->height - 3 * l->border - menu_h, 0);
+}
+
+/* the pixels of each column and row for the current layout. Cell edges are spread over the
+ * grid with integer arithmetic, a grid line on every edge but the first, and the cells just
+ * inside them; cells too small for lines share their edges, and are never less than a pixel */
+void _render_cell_geometry(RenderCache *c, const Layout *l)
+{
+  int edge, next_edge;
+
+  c->grid_lines = l->grid.w / (int)c->board_width >= GRID_LINES_MIN_CELL
+    && l->grid.h / (int)c->board_height >= GRID_LINES_MIN_CELL;
+  for (unsigned int x = 0; x < c->board_width; x++) {
+    edge = l->grid.x + (int)((Sint64)x * l->grid.w / c->board_width);
+    next_edge = l->grid.x + (int)((Sint64)(x + 1) * l->grid.w / c->board_width);
+    c->columns[x].start = x > 0 && c->grid_lines ? edge + 1 : edge;
+    c->columns[x].size = SDL_max(next_edge - c->columns[x].start, 1);
+  }
+  for (unsigned int y = 0; y < c->board_height; y++) {
+    edge = l->grid.y + (int)((Sint64)y * l->grid.h / c->board_height);
+    next_edge = l->grid.y + (int)((Sint64)(y + 1) * l->grid.h / c->board_height);
+    c->rows[y].start = y > 0 && c->grid_lines ? edge + 1 : edge;
+    c->rows[y].size = SDL_max(next_edge - c->rows[y].start, 1);
+  }
+}
+
+void _render_destroy_targets(RenderCache *c)
+{
+  if (c->static_layer != NULL)
+    SDL_DestroyTexture(c->static_layer);
+  if (c->canvas != NULL)
+    SDL_DestroyTexture(c->canvas);
+  c->static_layer = NULL;
+  c->canvas = NULL;
+  render_software_deinitialize(c);
+}
+
+/* the textures or pixel buffers the frame is drawn into, at the layout's size */
+bool _render_create_targets(GameState *state, RenderCache *c, bool software)
+{
+  if (software) {
+    if (!render_software_initialize(state, c)) {
+      fprintf(stderr, "[error]: Could not set up the software renderer\n");
+      render_software_deinitialize(c);
+      return false;
+    }
+  } else if (SDL_RenderTargetSupported(state->renderer)) {
+    c->static_layer = SDL_CreateTexture(state->renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+					state->layout.width, state->layout.height);
+    c->canvas = SDL_CreateTexture(state->renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+				  state->layout.width, state->layout.height);
+    if (c->static_layer == NULL || c->canvas == NULL) {
+      fprintf(stderr, "[error]: %s, drawing the board every frame instead\n", SDL_GetError());
+      _render_destroy_targets(c);
+    }
+  }
+  return true;
+}
+
+/* arena bytes render_initialize needs for a width x height board */
+size_t render_arena_size(unsigned int width, unsigned int height)
+{
+  return sizeof(RenderCache) + 2 * RENDER_CELL_BATCH * sizeof(SDL_Rect) + ((size_t)width + height) * sizeof(RenderSpan)
+    + OCCUPANCY_WORDS_FOR((size_t)width * height) * sizeof(Uint64) + 6 * ARENA_ALIGNMENT;
+}
+
+/* allocate the render cache from the game's arena for a width x height board and work out the
+ * layout and cell geometry once, instead of per draw */
+/* the software backend is used when the GameState has no accelerated renderer, which with
+ * SDL's dummy video driver means no renderer at all */
+bool render_initialize(GameState *state, bool software, unsigned int width, unsigned int height)
+{
+  RenderCache *c = arena_alloc(state->arena, sizeof(RenderCache));
+
+  if (c == NULL) {
+    fprintf(stderr, "[error]: Could not allocate memory for RenderCache\n");
+    return false;
+  }
+  memset(c, 0, sizeof(RenderCache));
+  c->board_width = width;
+  c->board_height = height;
+  c->occupancy_words = OCCUPANCY_WORDS_FOR(width * height);
+  c->snake_rects = arena_alloc(state->arena, RENDER_CELL_BATCH * sizeof(SDL_Rect));
+  c->empty_rects = arena_alloc(state->arena, RENDER_CELL_BATCH * sizeof(SDL_Rect));
+  c->columns = arena_alloc(state->arena, width * sizeof(RenderSpan));
+  c->rows = arena_alloc(state->arena, height * sizeof(RenderSpan));
+  c->presented_occupancy = arena_alloc(state->arena, c->occupancy_words * sizeof(Uint64));
+  if (c->snake_rects == NULL || c->empty_rects == NULL || c->columns == NULL || c->rows == NULL
+      || c->presented_occupancy == NULL) {
+    fprintf(stderr, "[error]: Could not allocate memory for RenderCache\n");
+    return false;
+  }
+
+  _render_layout(state);
+  _render_cell_geometry(c, &(state->layout));
+  if (!_render_create_targets(state, c, software))
+    return false;
+  text_initialize(&(c->text), c->software ? NULL : state->renderer);
+  text_layout(&(c->text), &(state->layout));
+  c->static_layer_dirty = true;
+  c->canvas_dirty = true;
+  c->exit_button_hover = false;
+  c->overlay_presented = -1;
+  c->telemetry_presented = false;
+  state->render_cache = c;
+  return true;
+}
+
+/* the window changed size, or moved to a display with another scale: lay it out again and
+ * recreate everything drawn at the old size */
+bool render_resize(GameState *state)
+{
+  RenderCache *c = state->render_cache;
+  bool software = c->software;
+  int width = state->layout.width, height = state->layout.height;
+
+  _render_layout(state);
+  _render_cell_geometry(c, &(state->layout));
+  text_layout(&(c->text), &(state->layout));
+  render_invalidate(state);
+  if (state->layout.width == width && state->layout.height == height)
+    return true;
+  _render_destroy_targets(c);
+  return _render_create_targets(state, c, software);
+}
+
+void render_deinitialize(GameState *state)
+{
+  if (state->render_cache == NULL)
+    return;
+  _render_destroy_targets(state->render_cache);
+  text_deinitialize(&(state->render_cache->text));
+  /* the cache itself goes with the arena */
+  state->render_cache = NULL;
+}
+
+/* render function is only responsible for drawing game objects */
+/* it draws the snapshot s, the simulation thread's latest. The canvas texture keeps the last
+ * frame's board, so a frame only patches the cells that differ from it; frames where nothing
+ * changed are not drawn at all. Returns true if there is a new frame for the caller to present */
+bool render(GameState *state, const Snapshot *s)
+{
+  SDL_Renderer *r = state->renderer;
+  RenderCache *c = state->render_cache;
+  const Layout *l = &(state->layout);
+  int overlay_kind = _render_overlay_kind(s);
+  bool full_repaint, text_changed;
+
+  /* hovering the exit button is the only thing that changes the static layer */
+  if (state->exit_button_hover != c->exit_button_hover) {
+    c->exit_button_hover = !c->exit_button_hover;
+    c->static_layer_dirty = true;
+  }
+
+  /* the numbers in the menu are laid out again only when they change */
+  text_changed = text_update(&(c->text), s);
+  full_repaint = (c->canvas == NULL && !c->software) || c->canvas_dirty || c->static_layer_dirty;
+  /* the telemetry bars change every frame, and need the menu under them redrawn when switched off */
+  if (state->telemetry->enabled != c->telemetry_presented) {
+    c->telemetry_presented = state->telemetry->enabled;
+    full_repaint = true;
+  }
+  if (!full_repaint && !_render_board_changed(c, s) && overlay_kind == c->overlay_presented
+      && !c->telemetry_presented && !text_changed)
+    return false;
+
+  if (c->software) {
+    _render_software(state, s, full_repaint, overlay_kind);
+  } else if (c->canvas != NULL) {
+    SDL_SetRenderTarget(r, c->canvas);
+    if (full_repaint) {
+      /* the static layer replaces clearing the screen; snake cells stop short of its grid lines */
+      _render_static_layer(r, c, l, c->canvas);
+      _render_snake(r, c, s);
+      /* a full board has no food left to draw */
+      if (!s->has_won)
+	_render_food(r, c, s->food);
+    } else {
+      _render_changed_cells(r, c, s);
+    }
+    _render_text(r, c, full_repaint);
+    SDL_SetRenderTarget(r, NULL);
+    SDL_RenderCopy(r, c->canvas, NULL, NULL);
+  } else {
+    /* no render targets: draw the whole frame, but still only when something changed */
+    _render_static_layer(r, c, l, NULL);
+    _render_snake(r, c, s);
+    if (!s->has_won)
+      _render_food(r, c, s->food);
+    _render_text(r, c, true);
+  }
+  if (!c->software) {
+    _render_overlay(r, l, overlay_kind);
+    if (c->telemetry_presented)
+      _render_telemetry(r, state->telemetry);
+  }
 
-  /* draw menu first, so that out-of-bounds drawing is visible */
-  _render_window_border(state->renderer);
-  _render_window_menu(state->renderer);
-  _render_snake(state->renderer, state->snake);
-  _render_food(state->renderer, state->food);
-  _render_grid(state->renderer);
-  _render_pause_overlay(state->renderer, state->is_paused);
-  _render_snake_dead(state->renderer, state->snake->is_alive);
-  
-  /* swap the buffers */
-  SDL_RenderPresent(r);
+  c->canvas_dirty = false;
+  c->overlay_presented = overlay_kind;
+  memcpy(c->presented_occupancy, s->occupancy, c->occupancy_words * sizeof(Uint64));
+  c->presented_food = s->food;
+  c->presented_food_visible = !s->has_won;
+  return true;
 }
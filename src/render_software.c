@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "types.h"
+#include "constants.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* the built-in software backend: the same frame render.c draws through SDL, rasterized into
+ * CPU pixel buffers with span fills, four pixels per store where SSE2 is available */
+
+#define SOFTWARE_PIXELS(c) ((size_t)(c)->software_width * (c)->software_height)
+
+/* arena.c functions */
+Arena * arena_create(size_t size);
+void * arena_alloc(Arena *a, size_t size);
+void arena_destroy(Arena *a);
+
+/* clip rect to the pixel buffers, false if nothing is left */
+bool _render_software_clip(RenderCache *c, SDL_Rect *rect)
+{
+  int x2 = rect->x + rect->w, y2 = rect->y + rect->h;
+
+  if (rect->x < 0)
+    rect->x = 0;
+  if (rect->y < 0)
+    rect->y = 0;
+  if (x2 > c->software_width)
+    x2 = c->software_width;
+  if (y2 > c->software_height)
+    y2 = c->software_height;
+  rect->w = x2 - rect->x;
+  rect->h = y2 - rect->y;
+  return rect->w > 0 && rect->h > 0;
+}
+
+void _render_software_fill_span(Uint32 *p, int n, Uint32 color)
+{
+#ifdef __SSE2__
+  __m128i v = _mm_set1_epi32((int)color);
+
+  for (; n >= 4; n -= 4, p += 4)
+    _mm_storeu_si128((__m128i *)p, v);
+#endif
+  for (; n > 0; n--)
+    *p++ = color;
+}
+
+/* color over the span at alpha / 256: dst = (src * alpha + dst * (256 - alpha)) / 256 per
+ * channel. With SSE2 the channels of four pixels are widened to 16 bits and blended at once */
+void _render_software_blend_span(Uint32 *p, int n, Uint32 color, Uint8 alpha)
+{
+  Uint32 inverse = 256 - alpha, d;
+
+#ifdef __SSE2__
+  __m128i zero = _mm_setzero_si128();
+  __m128i source = _mm_mullo_epi16(_mm_unpacklo_epi8(_mm_set1_epi32((int)color), zero),
+				   _mm_set1_epi16(alpha));
+  __m128i inverse_16 = _mm_set1_epi16((short)inverse);
+  __m128i dst, low, high;
+
+  for (; n >= 4; n -= 4, p += 4) {
+    dst = _mm_loadu_si128((__m128i *)p);
+    low = _mm_unpacklo_epi8(dst, zero);
+    high = _mm_unpackhi_epi8(dst, zero);
+    low = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(low, inverse_16), source), 8);
+    high = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(high, inverse_16), source), 8);
+    _mm_storeu_si128((__m128i *)p, _mm_packus_epi16(low, high));
+  }
+#endif
+  for (; n > 0; n--, p++) {
+    d = *p;
+    *p = (((((color >> 24) & 0xff) * alpha + ((d >> 24) & 0xff) * inverse) >> 8) << 24)
+      | (((((color >> 16) & 0xff) * alpha + ((d >> 16) & 0xff) * inverse) >> 8) << 16)
+      | (((((color >> 8) & 0xff) * alpha + ((d >> 8) & 0xff) * inverse) >> 8) << 8)
+      | ((((color & 0xff) * alpha + (d & 0xff) * inverse) >> 8));
+  }
+}
+
+void render_software_fill_rects(RenderCache *c, Uint32 *pixels, const SDL_Rect *rects, int count, Uint32 color)
+{
+  SDL_Rect rect;
+
+  for (int i = 0; i < count; i++) {
+    rect = rects[i];
+    if (!_render_software_clip(c, &rect))
+      continue;
+    for (int y = rect.y; y < rect.y + rect.h; y++)
+      _render_software_fill_span(pixels + (size_t)y * c->software_width + rect.x, rect.w, color);
+  }
+}
+
+void render_software_blend_rect(RenderCache *c, Uint32 *pixels, SDL_Rect rect, Uint32 color, Uint8 alpha)
+{
+  if (!_render_software_clip(c, &rect))
+    return;
+  for (int y = rect.y; y < rect.y + rect.h; y++)
+    _render_software_blend_span(pixels + (size_t)y * c->software_width + rect.x, rect.w, color, alpha);
+}
+
+/* pack an r, g, b color for the fill and blend functions */
+Uint32 render_software_color(Uint8 r, Uint8 g, Uint8 b)
+{
+  return 0xff000000u | ((Uint32)r << 16) | ((Uint32)g << 8) | b;
+}
+
+void render_software_copy(RenderCache *c, Uint32 *to, const Uint32 *from)
+{
+  memcpy(to, from, SOFTWARE_PIXELS(c) * sizeof(Uint32));
+}
+
+/* the menu text from the font atlas: every field, or only the dirty ones, each run of covered
+ * font pixels in a glyph row filled as one rect */
+void render_software_text(RenderCache *c, Uint32 *pixels, bool all)
+{
+  TextCache *t = &(c->text);
+  TextField *field;
+  const Uint8 *row;
+  SDL_Rect run;
+  int x;
+
+  for (int f = 0; f < TEXT_FIELDS; f++) {
+    field = t->fields + f;
+    if (!all && !field->dirty)
+      continue;
+    for (int g = 0; g < field->glyph_count; g++) {
+      for (int y = 0; y < TEXT_GLYPH_HEIGHT; y++) {
+	row = t->atlas_alpha + y * TEXT_ATLAS_WIDTH + field->glyphs[g] * (TEXT_GLYPH_WIDTH + 1);
+	for (x = 0; x < TEXT_GLYPH_WIDTH; x++) {
+	  if (row[x] == 0)
+	    continue;
+	  run.x = field->origins[g].x + x * t->pixel;
+	  run.y = field->origins[g].y + y * t->pixel;
+	  run.h = t->pixel;
+	  /* the atlas has an empty column after every glyph, so this stops inside it */
+	  while (row[x] != 0)
+	    x++;
+	  run.w = field->origins[g].x + x * t->pixel - run.x;
+	  render_software_fill_rects(c, pixels, &run, 1, render_software_color(TEXT_COLOR));
+	}
+      }
+    }
+  }
+}
+
+/* border, menu and grid into software_static, matching _render_window_border,
+ * _render_window_menu and _render_grid; SDL's lines include both end points */
+void render_software_static_layer(RenderCache *c, const Layout *l)
+{
+  Uint32 *p = c->software_static;
+  SDL_Rect border[] = {
+    {0, 0, l->border, l->height},
+    {l->width - l->border, 0, l->border, l->height},
+    {0, 0, l->width, l->border},
+    {0, l->height - l->border, l->width, l->border},
+    {0, l->menu.y + l->menu.h, l->width, l->border},
+    {l->exit_button.x - l->border, l->exit_button.y, l->border, l->exit_button.h}
+  };
+  SDL_Rect line;
+
+  _render_software_fill_span(p, (int)SOFTWARE_PIXELS(c), 0xff000000u);
+  render_software_fill_rects(c, p, border, sizeof(border) / sizeof(border[0]),
+			     render_software_color(WINDOW_BORDER_COLOR));
+  if (c->exit_button_hover)
+    render_software_fill_rects(c, p, &l->exit_button, 1, render_software_color(MENU_EXIT_BUTTON_COLOR_HOVER));
+  else
+    render_software_fill_rects(c, p, &l->exit_button, 1, render_software_color(MENU_EXIT_BUTTON_COLOR));
+
+  for (unsigned int i = 1; c->grid_lines && i < c->board_width; i++) {
+    line.x = c->columns[i].start - 1;
+    line.y = l->grid.y;
+    line.w = 1;
+    line.h = l->grid.h + 1;
+    render_software_fill_rects(c, p, &line, 1, render_software_color(GRID_COLOR));
+  }
+  for (unsigned int i = 1; c->grid_lines && i < c->board_height; i++) {
+    line.x = l->grid.x;
+    line.y = c->rows[i].start - 1;
+    line.w = l->grid.w + 1;
+    line.h = 1;
+    render_software_fill_rects(c, p, &line, 1, render_software_color(GRID_COLOR));
+  }
+}
+
+/* upload the finished frame; without a window it stays in memory */
+void render_software_present(GameState *state, const Uint32 *pixels)
+{
+  RenderCache *c = state->render_cache;
+
+  if (c->software_texture == NULL)
+    return;
+  if (SDL_UpdateTexture(c->software_texture, NULL, pixels, c->software_width * sizeof(Uint32)) != 0
+      || SDL_RenderCopy(state->renderer, c->software_texture, NULL, NULL) != 0)
+    fprintf(stderr, "[error]: %s\n", SDL_GetError());
+}
+
+/* the pixel buffers at the layout's size, and the streaming texture if there is a renderer to
+ * show them with; a resize throws them away and calls this again */
+bool render_software_initialize(GameState *state, RenderCache *c)
+{
+  c->software_width = state->layout.width;
+  c->software_height = state->layout.height;
+  c->software_arena = arena_create(3 * (SOFTWARE_PIXELS(c) * sizeof(Uint32) + ARENA_ALIGNMENT));
+  if (c->software_arena == NULL)
+    return false;
+  c->software_static = arena_alloc(c->software_arena, SOFTWARE_PIXELS(c) * sizeof(Uint32));
+  c->software_canvas = arena_alloc(c->software_arena, SOFTWARE_PIXELS(c) * sizeof(Uint32));
+  c->software_frame = arena_alloc(c->software_arena, SOFTWARE_PIXELS(c) * sizeof(Uint32));
+  if (c->software_static == NULL || c->software_canvas == NULL || c->software_frame == NULL)
+    return false;
+
+  c->software_texture = NULL;
+  if (state->renderer != NULL) {
+    c->software_texture = SDL_CreateTexture(state->renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+					    c->software_width, c->software_height);
+    if (c->software_texture == NULL) {
+      fprintf(stderr, "[error]: %s\n", SDL_GetError());
+      return false;
+    }
+  }
+  c->software = true;
+  return true;
+}
+
+void render_software_deinitialize(RenderCache *c)
+{
+  if (c->software_texture != NULL)
+    SDL_DestroyTexture(c->software_texture);
+  c->software_texture = NULL;
+  if (c->software_arena != NULL)
+    arena_destroy(c->software_arena);
+  c->software_arena = NULL;
+  c->software_presented = NULL;
+  c->software = false;
+}
@@ -0,0 +1,520 @@
+/* mmap and posix_madvise under -std=c99 */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <SDL2/SDL.h>
+
+#include "types.h"
+#include "constants.h"
+
+/* replays: a game is its seed plus the direction passed to step() on every tick, since step is
+ * the whole simulation. A file, all integers little endian, is
+ *   header    "SNKR", version, board width and height, seed, keyframe interval, --move-ms
+ *             (32 bytes)
+ *   records   one byte per run of ticks in one direction: direction | (ticks - 1) << 2, runs of
+ *             up to REPLAY_RUN_MAX ticks; REPLAY_KEYFRAME, its size and a keyframe; REPLAY_END
+ *   index     keyframe count, then the tick and file offset of each keyframe
+ *   footer    offset of the index, ticks recorded, the game tick, score and head cell after the
+ *             last of them, "SNKI" and 4 spare bytes  (40 bytes)
+ * A keyframe is the whole game at a tick, free list order included, so playback can start
+ * there. Games follow each other on one random stream: the next tick after a game ends
+ * starts a new one. Playing the whole replay has to end where the recorded game did */
+
+#define REPLAY_VERSION 2
+#define REPLAY_HEADER_SIZE 32
+#define REPLAY_FOOTER_SIZE 40
+#define REPLAY_RUN_MAX 63
+#define REPLAY_KEYFRAME 0xff
+#define REPLAY_END 0xfe
+/* ticks between keyframes; replaying that many from a keyframe takes well under a millisecond */
+#define REPLAY_KEYFRAME_TICKS 16384
+/* keyframes the index can hold, about 270 million ticks; later ones are not written */
+#define REPLAY_KEYFRAMES_MAX 16384
+/* fixed part of a keyframe, before the body and free cells */
+#define REPLAY_KEYFRAME_FIXED 68
+#define REPLAY_BUFFER_SIZE 65536
+
+/* arena.c functions */
+Arena * arena_create(size_t size);
+void * arena_alloc(Arena *a, size_t size);
+void arena_destroy(Arena *a);
+
+/* snake.c functions */
+size_t snake_arena_size(unsigned int width, unsigned int height);
+Snake * snake_create(Arena *a, unsigned int width, unsigned int height);
+bool snake_restore(Snake *s, const Uint32 *body, unsigned int length, const Uint32 *free_cells,
+		   unsigned int free_cell_count);
+void snake_iterate(const Snake *s, SnakeIterator *it);
+bool snake_iterate_next(SnakeIterator *it, SnakeSegment *seg);
+
+/* update.c functions */
+bool reset(GameState *state);
+void step(GameState *state, Direction action);
+
+/* rng.c functions */
+void rng_seed(Rng *r, Uint64 seed, Uint64 stream);
+
+/* an open replay for playback: the whole file mapped read only */
+typedef struct {
+  const Uint8 *data;
+  size_t size;
+  unsigned int width;
+  unsigned int height;
+  Uint64 seed;
+  Uint64 move_delay_ms; /* the game's --move-ms, 0 for the default */
+  size_t records; /* offset of the first record */
+  size_t records_end; /* offset of the index, or the end of the file without one */
+  const Uint8 *index; /* NULL if the recording was cut short */
+  unsigned int keyframes;
+  Uint64 ticks; /* recorded, 0 if unknown */
+  /* the game after the last recorded tick */
+  Uint64 end_tick;
+  Uint32 end_score;
+  Uint32 end_head; /* cell, y * width + x */
+} ReplayReader;
+
+void _replay_put32(Uint8 *p, Uint32 v)
+{
+  for (int i = 0; i < 4; i++)
+    p[i] = (Uint8)(v >> (8 * i));
+}
+
+void _replay_put64(Uint8 *p, Uint64 v)
+{
+  for (int i = 0; i < 8; i++)
+    p[i] = (Uint8)(v >> (8 * i));
+}
+
+Uint32 _replay_get32(const Uint8 *p)
+{
+  return (Uint32)p[0] | (Uint32)p[1] << 8 | (Uint32)p[2] << 16 | (Uint32)p[3] << 24;
+}
+
+Uint64 _replay_get64(const Uint8 *p)
+{
+  return (Uint64)_replay_get32(p) | (Uint64)_replay_get32(p + 4) << 32;
+}
+
+/* the size of a keyframe of a board of cells cells */
+size_t _replay_keyframe_size(size_t cells)
+{
+  return REPLAY_KEYFRAME_FIXED + cells * sizeof(Uint32);
+}
+
+void _replay_write(ReplayWriter *w, const void *data, size_t size)
+{
+  if (!w->failed && fwrite(data, 1, size, w->file) != size)
+    w->failed = true;
+  w->offset += size;
+}
+
+void _replay_flush_run(ReplayWriter *w)
+{
+  Uint8 record = (Uint8)(w->run_direction | (w->run_length - 1) << 2);
+
+  if (w->run_length == 0)
+    return;
+  _replay_write(w, &record, 1);
+  w->run_length = 0;
+}
+
+/* the game as it is before the next tick, into the file and the index */
+void _replay_write_keyframe(ReplayWriter *w, GameState *state)
+{
+  Snake *s = state->snake;
+  Uint8 *p = w->scratch;
+  Uint8 marker = REPLAY_KEYFRAME;
+  Uint8 size[4];
+  SnakeIterator it;
+  SnakeSegment segment;
+
+  w->index[w->keyframes].tick = w->ticks;
+  w->index[w->keyframes].offset = w->offset;
+  w->keyframes++;
+
+  _replay_put64(p, w->ticks);
+  _replay_put64(p + 8, state->rng.state);
+  _replay_put64(p + 16, state->rng.increment);
+  _replay_put64(p + 24, state->tick);
+  _replay_put64(p + 32, s->move_delay_ms);
+  _replay_put32(p + 40, state->score);
+  _replay_put32(p + 44, state->food.x);
+  _replay_put32(p + 48, state->food.y);
+  _replay_put32(p + 52, s->direction);
+  _replay_put32(p + 56, s->direction_queued);
+  _replay_put32(p + 60, s->length);
+  _replay_put32(p + 64, s->free_cell_count);
+  p += REPLAY_KEYFRAME_FIXED;
+  snake_iterate(s, &it);
+  for (; snake_iterate_next(&it, &segment); p += 4)
+    _replay_put32(p, segment.y * s->width + segment.x);
+  for (unsigned int i = 0; i < s->free_cell_count; i++, p += 4)
+    _replay_put32(p, s->free_cells[i]);
+
+  _replay_put32(size, (Uint32)(p - w->scratch));
+  _replay_write(w, &marker, 1);
+  _replay_write(w, size, 4);
+  _replay_write(w, w->scratch, p - w->scratch);
+}
+
+/* arena bytes replay_open needs for a width x height board */
+size_t replay_arena_size(unsigned int width, unsigned int height)
+{
+  return sizeof(ReplayWriter) + REPLAY_BUFFER_SIZE + REPLAY_KEYFRAMES_MAX * sizeof(ReplayKeyframe)
+    + _replay_keyframe_size((size_t)width * height) + 4 * ARENA_ALIGNMENT;
+}
+
+/* start recording the game of a width x height board played from seed into path; everything
+ * it needs, the stdio buffer included, comes from the arena */
+ReplayWriter * replay_open(Arena *a, const char *path, unsigned int width, unsigned int height, Uint64 seed,
+			   Uint64 move_delay_ms)
+{
+  ReplayWriter *w = arena_alloc(a, sizeof(ReplayWriter));
+  Uint8 header[REPLAY_HEADER_SIZE];
+
+  if (w == NULL) {
+    fprintf(stderr, "[error]: Could not allocate memory for the replay\n");
+    return NULL;
+  }
+  memset(w, 0, sizeof(ReplayWriter));
+  w->buffer = arena_alloc(a, REPLAY_BUFFER_SIZE);
+  w->index = arena_alloc(a, REPLAY_KEYFRAMES_MAX * sizeof(ReplayKeyframe));
+  w->scratch = arena_alloc(a, _replay_keyframe_size((size_t)width * height));
+  if (w->buffer == NULL || w->index == NULL || w->scratch == NULL) {
+    fprintf(stderr, "[error]: Could not allocate memory for the replay\n");
+    return NULL;
+  }
+  w->file = fopen(path, "wb");
+  if (w->file == NULL) {
+    fprintf(stderr, "[error]: Could not open %s for the replay\n", path);
+    return NULL;
+  }
+  setvbuf(w->file, w->buffer, _IOFBF, REPLAY_BUFFER_SIZE);
+
+  memset(header, 0, sizeof(header));
+  memcpy(header, "SNKR", 4);
+  _replay_put32(header + 4, REPLAY_VERSION);
+  _replay_put32(header + 8, width);
+  _replay_put32(header + 12, height);
+  _replay_put64(header + 16, seed);
+  _replay_put32(header + 24, REPLAY_KEYFRAME_TICKS);
+  _replay_put32(header + 28, (Uint32)move_delay_ms);
+  _replay_write(w, header, sizeof(header));
+  return w;
+}
+
+/* the simulation is about to step the game with action: add it to the current run, after a
+ * keyframe if one is due. Keyframes go between runs, so a run never spans one */
+void replay_record(ReplayWriter *w, GameState *state, Direction action)
+{
+  if (w->ticks % REPLAY_KEYFRAME_TICKS == 0 && w->keyframes < REPLAY_KEYFRAMES_MAX) {
+    _replay_flush_run(w);
+    _replay_write_keyframe(w, state);
+  }
+  if (w->run_length > 0 && (w->run_direction != action || w->run_length == REPLAY_RUN_MAX))
+    _replay_flush_run(w);
+  w->run_direction = action;
+  w->run_length++;
+  w->ticks++;
+}
+
+/* the simulation has stepped the game: keep where it ended up for the footer, since a restart
+ * before the next tick would hide it by the time the replay is closed */
+void replay_stepped(ReplayWriter *w, GameState *state)
+{
+  w->end_tick = state->tick;
+  w->end_score = state->score;
+  w->end_head = state->snake->head_position.y * state->snake->width + state->snake->head_position.x;
+}
+
+/* finish the records, write the index and footer and close the file; the simulation thread
+ * must have stopped */
+void replay_close(ReplayWriter *w)
+{
+  Uint8 end = REPLAY_END, entry[16], footer[REPLAY_FOOTER_SIZE];
+  Uint64 index_offset;
+
+  if (w == NULL)
+    return;
+  _replay_flush_run(w);
+  _replay_write(w, &end, 1);
+  index_offset = w->offset;
+  _replay_put32(entry, w->keyframes);
+  _replay_write(w, entry, 4);
+  for (unsigned int i = 0; i < w->keyframes; i++) {
+    _replay_put64(entry, w->index[i].tick);
+    _replay_put64(entry + 8, w->index[i].offset);
+    _replay_write(w, entry, 16);
+  }
+  memset(footer, 0, sizeof(footer));
+  _replay_put64(footer, index_offset);
+  _replay_put64(footer + 8, w->ticks);
+  _replay_put64(footer + 16, w->end_tick);
+  _replay_put32(footer + 24, w->end_score);
+  _replay_put32(footer + 28, w->end_head);
+  memcpy(footer + 32, "SNKI", 4);
+  _replay_write(w, footer, sizeof(footer));
+
+  if (fclose(w->file) != 0)
+    w->failed = true;
+  w->file = NULL;
+  if (w->failed)
+    fprintf(stderr, "[error]: Could not write the whole replay\n");
+  else
+    fprintf(stdout, "[info]: replay of %llu ticks, %llu bytes, %u keyframes\n", (unsigned long long)w->ticks,
+	    (unsigned long long)w->offset, w->keyframes);
+}
+
+void _replay_unmap(ReplayReader *r)
+{
+  if (r->data != NULL)
+    munmap((void *)r->data, r->size);
+  r->data = NULL;
+}
+
+/* map path and check its header; the index is optional, a recording cut short has none */
+bool _replay_map(ReplayReader *r, const char *path)
+{
+  struct stat st;
+  int fd = open(path, O_RDONLY);
+  const Uint8 *footer;
+  Uint64 index_offset;
+
+  memset(r, 0, sizeof(ReplayReader));
+  if (fd < 0 || fstat(fd, &st) != 0 || st.st_size < REPLAY_HEADER_SIZE) {
+    fprintf(stderr, "[error]: Could not read the replay %s\n", path);
+    if (fd >= 0)
+      close(fd);
+    return false;
+  }
+  r->size = (size_t)st.st_size;
+  r->data = mmap(NULL, r->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (r->data == MAP_FAILED) {
+    r->data = NULL;
+    fprintf(stderr, "[error]: Could not map the replay %s\n", path);
+    return false;
+  }
+  /* playback reads it front to back, apart from the seeks */
+  posix_madvise((void *)r->data, r->size, POSIX_MADV_SEQUENTIAL);
+
+  r->width = _replay_get32(r->data + 8);
+  r->height = _replay_get32(r->data + 12);
+  if (memcmp(r->data, "SNKR", 4) != 0 || _replay_get32(r->data + 4) != REPLAY_VERSION
+      || r->width < BOARD_WIDTH_MIN || r->width > BOARD_SIZE_MAX
+      || r->height < BOARD_HEIGHT_MIN || r->height > BOARD_SIZE_MAX) {
+    fprintf(stderr, "[error]: %s is not a replay this version can play\n", path);
+    _replay_unmap(r);
+    return false;
+  }
+  r->seed = _replay_get64(r->data + 16);
+  r->move_delay_ms = _replay_get32(r->data + 28);
+  r->records = REPLAY_HEADER_SIZE;
+  r->records_end = r->size;
+
+  footer = r->data + r->size - REPLAY_FOOTER_SIZE;
+  if (r->size >= REPLAY_HEADER_SIZE + REPLAY_FOOTER_SIZE + 4 && memcmp(footer + 32, "SNKI", 4) == 0) {
+    index_offset = _replay_get64(footer);
+    if (index_offset >= r->records && index_offset + 4 <= r->size - REPLAY_FOOTER_SIZE) {
+      r->keyframes = _replay_get32(r->data + index_offset);
+      if ((Uint64)r->keyframes * 16 <= r->size - REPLAY_FOOTER_SIZE - index_offset - 4) {
+	r->index = r->data + index_offset + 4;
+	r->records_end = (size_t)index_offset;
+	r->ticks = _replay_get64(footer + 8);
+	r->end_tick = _replay_get64(footer + 16);
+	r->end_score = _replay_get32(footer + 24);
+	r->end_head = _replay_get32(footer + 28);
+      }
+    }
+  }
+  if (r->index == NULL)
+    fprintf(stdout, "[info]: the replay has no index, it was cut short; playing it from the start\n");
+  return true;
+}
+
+/* load the keyframe at offset into state; false if it doesn't fit the board */
+bool _replay_restore(ReplayReader *r, GameState *state, size_t offset, Uint64 *tick, size_t *next)
+{
+  const Uint8 *p = r->data + offset;
+  Snake *s = state->snake;
+  Uint32 size, length, free_count, cell;
+  const Uint8 *cells;
+  Uint32 *body = s->free_cell_slot;
+
+  if (offset + 5 > r->records_end || p[0] != REPLAY_KEYFRAME)
+    return false;
+  size = _replay_get32(p + 1);
+  if (size < REPLAY_KEYFRAME_FIXED || offset + 5 + size > r->records_end)
+    return false;
+  p += 5;
+  length = _replay_get32(p + 60);
+  free_count = _replay_get32(p + 64);
+  if (length < 1 || (Uint64)length + free_count != s->cell_count
+      || size != _replay_keyframe_size(s->cell_count))
+    return false;
+
+  /* the body is collected in free_cell_slot, which snake_restore rebuilds after using it */
+  cells = p + REPLAY_KEYFRAME_FIXED;
+  for (Uint32 i = 0; i < s->cell_count; i++) {
+    cell = _replay_get32(cells + 4 * i);
+    if (cell >= s->cell_count)
+      return false;
+    if (i < length)
+      body[i] = cell;
+    else
+      s->free_cells[i - length] = cell;
+  }
+  if (!snake_restore(s, body, length, s->free_cells, free_count))
+    return false;
+
+  *tick = _replay_get64(p);
+  state->rng.state = _replay_get64(p + 8);
+  state->rng.increment = _replay_get64(p + 16);
+  state->tick = _replay_get64(p + 24);
+  s->move_delay_ms = _replay_get64(p + 32);
+  state->score = _replay_get32(p + 40);
+  state->food.x = _replay_get32(p + 44) % s->width;
+  state->food.y = _replay_get32(p + 48) % s->height;
+  s->direction = (Direction)(_replay_get32(p + 52) & 3);
+  s->direction_queued = (Direction)(_replay_get32(p + 56) & 3);
+  s->is_alive = true;
+  s->has_won = false;
+  *next = offset + 5 + size;
+  return true;
+}
+
+/* the last keyframe at or before tick, as an offset into the file; 0 if there is none */
+size_t _replay_find_keyframe(ReplayReader *r, Uint64 tick)
+{
+  unsigned int low = 0, high = r->keyframes, middle;
+
+  /* the first keyframe after tick is at low once the search closes */
+  while (low < high) {
+    middle = low + (high - low) / 2;
+    if (_replay_get64(r->index + 16 * middle) <= tick)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return low > 0 ? (size_t)_replay_get64(r->index + 16 * (low - 1) + 8) : 0;
+}
+
+/* play a replay as fast as the simulation goes, from the start or, with seek, from the last
+ * keyframe before tick seek_tick up to it, and report where the game stands at the end */
+int replay_play(const char *path, bool seek, Uint64 seek_tick)
+{
+  ReplayReader r;
+  GameState state;
+  Arena *arena;
+  size_t at, keyframe;
+  Uint64 tick = 0, start_tick = 0, games = 1, played_ms = 0, best_score = 0, start;
+  unsigned int run, head;
+  int result = 0;
+  Direction direction;
+  Uint8 record;
+  double seconds;
+  bool done = false;
+
+  if (!_replay_map(&r, path))
+    return -1;
+  memset(&state, 0, sizeof(state));
+  arena = arena_create(snake_arena_size(r.width, r.height));
+  if (arena == NULL || (state.snake = snake_create(arena, r.width, r.height)) == NULL) {
+    if (arena != NULL)
+      arena_destroy(arena);
+    _replay_unmap(&r);
+    return -1;
+  }
+
+  start = SDL_GetPerformanceCounter();
+  /* the first game starts like the interactive one: seeded, then reset */
+  state.options.move_delay_ms = r.move_delay_ms;
+  rng_seed(&(state.rng), r.seed, 0);
+  reset(&state);
+  at = r.records;
+  if (seek && r.index != NULL && (keyframe = _replay_find_keyframe(&r, seek_tick)) != 0) {
+    if (!_replay_restore(&r, &state, keyframe, &tick, &at)) {
+      fprintf(stderr, "[error]: the replay's keyframe at byte %lu is damaged\n", (unsigned long)keyframe);
+      arena_destroy(arena);
+      _replay_unmap(&r);
+      return -1;
+    }
+    start_tick = tick;
+  }
+
+  while (!done && at < r.records_end && (!seek || tick < seek_tick)) {
+    record = r.data[at];
+    if (record == REPLAY_END)
+      break;
+    if (record == REPLAY_KEYFRAME) {
+      /* played through already, so skip it */
+      if (at + 5 > r.records_end)
+	break;
+      at += 5 + _replay_get32(r.data + at + 1);
+      continue;
+    }
+    direction = (Direction)(record & 3);
+    run = (record >> 2) + 1;
+    for (unsigned int i = 0; i < run; i++) {
+      if (seek && tick == seek_tick) {
+	done = true;
+	break;
+      }
+      /* a tick after a finished game belongs to the next one */
+      if (!state.snake->is_alive || state.snake->has_won) {
+	reset(&state);
+	games++;
+      }
+      played_ms += state.snake->move_delay_ms;
+      step(&state, direction);
+      if (state.score > best_score)
+	best_score = state.score;
+      tick++;
+    }
+    if (!done)
+      at++;
+  }
+  seconds = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+
+  if (seek) {
+    fprintf(stdout, "[info]: tick %llu: game tick %llu, score %u, length %u, head %u,%u, food %u,%u, %s\n",
+	    (unsigned long long)tick, (unsigned long long)state.tick, state.score, state.snake->length,
+	    state.snake->head_position.x, state.snake->head_position.y,
+	    state.food.x, state.food.y,
+	    state.snake->has_won ? "won" : state.snake->is_alive ? "alive" : "dead");
+    fprintf(stdout, "[info]: seeked from the keyframe at tick %llu, %llu ticks replayed in %.3f ms\n",
+	    (unsigned long long)start_tick, (unsigned long long)(tick - start_tick), seconds * 1000.0);
+  } else {
+    fprintf(stdout, "[info]: replay of %llu ticks on %ux%u, %llu games, best score %llu, in %.3f s "
+	    "(%.0f ticks/s, %.0fx real time)\n",
+	    (unsigned long long)tick, r.width, r.height, (unsigned long long)games,
+	    (unsigned long long)best_score, seconds, seconds > 0 ? tick / seconds : 0.0,
+	    seconds > 0 ? played_ms / 1000.0 / seconds : 0.0);
+    if (r.ticks != 0 && r.ticks != tick) {
+      fprintf(stderr, "[error]: the replay should have %llu ticks\n", (unsigned long long)r.ticks);
+      result = -1;
+    } else if (r.ticks != 0) {
+      /* the same seed and actions have to give the same game */
+      head = state.snake->head_position.y * r.width + state.snake->head_position.x;
+      if (state.tick != r.end_tick || state.score != r.end_score || head != r.end_head) {
+	fprintf(stderr, "[error]: the replay ends at game tick %llu, score %u, head %u,%u, but the recorded game "
+		"ended at game tick %llu, score %u, head %u,%u\n",
+		(unsigned long long)state.tick, state.score, head % r.width, head / r.width,
+		(unsigned long long)r.end_tick, r.end_score, r.end_head % r.width, r.end_head / r.width);
+	result = -1;
+      } else {
+	fprintf(stdout, "[info]: ends at game tick %llu, score %u, head %u,%u, as the recorded game did\n",
+		(unsigned long long)state.tick, state.score, head % r.width, head / r.width);
+      }
+    }
+  }
+  arena_destroy(arena);
+  _replay_unmap(&r);
+  return result;
+}
@@ -0,0 +1,58 @@
+#include <time.h>
+#include <SDL2/SDL.h>
+#include "types.h"
+
+/* PCG32 (XSH RR): a 64 bit linear congruential generator with a permuted 32 bit output. The
+ * increment picks one of 2^63 streams, so one seed gives every game its own independent,
+ * reproducible sequence just by numbering them */
+
+#define RNG_MULTIPLIER 6364136223846793005ULL
+
+/* start r on stream stream of seed; the same pair always gives the same sequence */
+void rng_seed(Rng *r, Uint64 seed, Uint64 stream)
+{
+  r->state = 0;
+  r->increment = (stream << 1) | 1;
+  r->state = r->state * RNG_MULTIPLIER + r->increment;
+  r->state += seed;
+  r->state = r->state * RNG_MULTIPLIER + r->increment;
+}
+
+Uint32 rng_next(Rng *r)
+{
+  Uint64 old = r->state;
+  Uint32 shifted = (Uint32)(((old >> 18) ^ old) >> 27);
+  Uint32 rotation = (Uint32)(old >> 59);
+
+  r->state = old * RNG_MULTIPLIER + r->increment;
+  return (shifted >> rotation) | (shifted << ((32 - rotation) & 31));
+}
+
+/* uniform in [0, bound), bound > 0, without the bias of rng_next() % bound (Lemire's method):
+ * the top half of a 64 bit product is the draw, and the few products whose bottom half lands
+ * in the uneven remainder are drawn again. The division only happens on that rare path */
+Uint32 rng_below(Rng *r, Uint32 bound)
+{
+  Uint64 product = (Uint64)rng_next(r) * bound;
+  Uint32 low = (Uint32)product, threshold;
+
+  if (low < bound) {
+    threshold = (0u - bound) % bound;
+    while (low < threshold) {
+      product = (Uint64)rng_next(r) * bound;
+      low = (Uint32)product;
+    }
+  }
+  return (Uint32)(product >> 32);
+}
+
+/* a seed for runs without --seed, from the clock; print it so the run can be repeated */
+Uint64 rng_clock_seed(void)
+{
+  Uint64 seed = (Uint64)time(NULL) ^ SDL_GetPerformanceCounter();
+
+  /* splitmix64's finalizer, so nearby clock values give unrelated seeds */
+  seed = (seed ^ (seed >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  seed = (seed ^ (seed >> 27)) * 0x94d049bb133111ebULL;
+  return seed ^ (seed >> 31);
+}
@@ -0,0 +1,338 @@
+/* shm_open, ftruncate, mmap, clock_gettime and sched_yield under -std=c99 */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <SDL2/SDL.h>
+
+#include "types.h"
+#include "constants.h"
+#include "logic.h"
+
+/* game state for bots and observers in other processes (--share name): the game creates the
+ * POSIX shared memory object /name, a SharedState and the occupancy bitmap, and publishes into
+ * it after every tick. Readers copy it under the seqlock, so they never block the game, and a
+ * bot steers through the command word, which the game reads once a tick and acknowledges,
+ * with the tick it was applied on, in the snapshot after that tick */
+
+#define SHARE_VERSION 1
+#define SHARE_PATH_MAX 256
+/* every this many commands the stand-in bot sends a reversal, which the game must ignore */
+#define SHARE_BOT_REVERSAL_EVERY 50
+
+/* arena.c functions */
+Arena * arena_create(size_t size);
+void * arena_alloc(Arena *a, size_t size);
+void arena_destroy(Arena *a);
+
+/* policy.c functions */
+Direction policy_greedy(GameState *state);
+
+/* shm_open wants a name of one leading slash and no others */
+bool _share_path(const char *name, char *path)
+{
+  int n = snprintf(path, SHARE_PATH_MAX, "%s%s", name[0] == '/' ? "" : "/", name);
+
+  if (n < 2 || n >= SHARE_PATH_MAX || strchr(path + 1, '/') != NULL) {
+    fprintf(stderr, "[error]: %s is not a name for shared memory\n", name);
+    return false;
+  }
+  return true;
+}
+
+/* the same clock in every process, unlike the performance counter */
+Uint64 _share_now_ns(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (Uint64)t.tv_sec * 1000000000 + (Uint64)t.tv_nsec;
+}
+
+size_t _share_region_size(unsigned int width, unsigned int height)
+{
+  return sizeof(SharedState) + OCCUPANCY_WORDS_FOR((size_t)width * height) * sizeof(Uint64);
+}
+
+/* arena bytes share_open needs */
+size_t share_arena_size(void)
+{
+  return sizeof(Share) + ARENA_ALIGNMENT;
+}
+
+/* copy the game into the region, between the two bumps of the sequence */
+void share_publish(Share *share, GameState *state)
+{
+  SharedState *r = share->region;
+  Snake *s = state->snake;
+
+  SDL_AtomicAdd(&r->sequence, 1); /* odd: write in progress */
+  SDL_MemoryBarrierRelease();
+  r->publish_ns = _share_now_ns();
+  r->tick = state->tick;
+  r->command_tick = share->command_tick;
+  r->command_ns = share->command_ns;
+  r->command_applied = share->command_applied;
+  r->head_x = s->head_position.x;
+  r->head_y = s->head_position.y;
+  r->tail_x = s->tail_position.x;
+  r->tail_y = s->tail_position.y;
+  r->food_x = state->food.x;
+  r->food_y = state->food.y;
+  r->score = state->score;
+  r->length = s->length;
+  r->direction = s->direction;
+  r->is_alive = s->is_alive;
+  r->has_won = s->has_won;
+  r->is_paused = state->is_paused;
+  memcpy(share->occupancy, s->occupancy, r->occupancy_words * sizeof(Uint64));
+  SDL_MemoryBarrierRelease();
+  SDL_AtomicAdd(&r->sequence, 1); /* even: the snapshot is consistent again */
+  share->published++;
+}
+
+/* the simulation is about to run a tick: a new command from the bot replaces action, the
+ * direction step() is given, so a reversal is refused there like a key press. Either way the
+ * command is acknowledged as taken on this tick */
+void share_take_command(Share *share, GameState *state, Direction *action)
+{
+  int command = SDL_AtomicGet(&(share->region->command));
+
+  if (command == share->command_seen)
+    return;
+  share->command_seen = command;
+  *action = (Direction)(command & 3);
+  share->command_applied = (Uint32)command >> 2;
+  share->command_tick = state->tick + 1;
+  share->command_ns = _share_now_ns();
+  share->commands++;
+}
+
+/* create the shared memory /name, sized for the game's board, and publish the game as it is; a
+ * region left behind under that name by a game that crashed is replaced */
+Share * share_open(Arena *a, const char *name, GameState *state)
+{
+  Share *share = arena_alloc(a, sizeof(Share));
+  char path[SHARE_PATH_MAX];
+  SharedState *r;
+  void *region;
+  int fd;
+
+  if (share == NULL) {
+    fprintf(stderr, "[error]: Could not allocate memory for the shared state\n");
+    return NULL;
+  }
+  if (!_share_path(name, path))
+    return NULL;
+  share->name = name;
+  share->size = _share_region_size(state->snake->width, state->snake->height);
+
+  shm_unlink(path);
+  fd = shm_open(path, O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    fprintf(stderr, "[error]: Could not create shared memory %s: %s\n", path, strerror(errno));
+    return NULL;
+  }
+  /* a new object is zeroed as it grows */
+  if (ftruncate(fd, (off_t)share->size) != 0) {
+    fprintf(stderr, "[error]: Could not size shared memory %s: %s\n", path, strerror(errno));
+    close(fd);
+    shm_unlink(path);
+    return NULL;
+  }
+  region = mmap(NULL, share->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (region == MAP_FAILED) {
+    fprintf(stderr, "[error]: Could not map shared memory %s: %s\n", path, strerror(errno));
+    shm_unlink(path);
+    return NULL;
+  }
+  share->region = r = region;
+  share->occupancy = (Uint64 *)(r + 1);
+
+  memcpy(r->magic, "SNKS", 4);
+  r->version = SHARE_VERSION;
+  r->width = state->snake->width;
+  r->height = state->snake->height;
+  r->occupancy_words = OCCUPANCY_WORDS_FOR(state->snake->cell_count);
+  share_publish(share, state);
+  SDL_AtomicSet(&r->open, 1);
+  return share;
+}
+
+/* tell readers the game is gone and remove the region; the simulation thread must have stopped */
+void share_close(Share *share)
+{
+  char path[SHARE_PATH_MAX];
+
+  if (share == NULL)
+    return;
+  SDL_AtomicSet(&(share->region->open), 0);
+  munmap(share->region, share->size);
+  if (_share_path(share->name, path))
+    shm_unlink(path);
+  fprintf(stdout, "[info]: shared %llu snapshots, took %llu commands\n", (unsigned long long)share->published,
+	  (unsigned long long)share->commands);
+}
+
+/* a consistent copy of the snapshot and the bitmap, retried while the game writes over it */
+void _share_read(SharedState *r, SharedState *view, Uint64 *occupancy)
+{
+  int sequence;
+
+  do {
+    sequence = SDL_AtomicGet(&r->sequence);
+    SDL_MemoryBarrierAcquire();
+    *view = *r;
+    memcpy(occupancy, r + 1, r->occupancy_words * sizeof(Uint64));
+    SDL_MemoryBarrierAcquire();
+  } while ((sequence & 1) || sequence != SDL_AtomicGet(&r->sequence));
+}
+
+/* the stand-in bot (--bot name): map the region of a game started with --share name, steer it
+ * with the greedy policy once per tick it sees, and time each command from the publish of the
+ * snapshot it answered to its write, and to the game applying it. Now and then, when going
+ * straight on is safe, it sends a reversal instead and checks the game ignored it. It polls,
+ * yielding the CPU between polls, until the game exits or max_commands (0 for no limit) are
+ * sent; returns -1 if a reversal was taken */
+int share_bot(const char *name, unsigned long max_commands)
+{
+  char path[SHARE_PATH_MAX];
+  struct stat st;
+  SharedState *r, view;
+  LatencySamples to_command, to_applied;
+  GameState state;
+  Arena *arena;
+  Snake *s;
+  void *region;
+  int fd, sequence, last_sequence = -1;
+  Uint32 number = 0;
+  Uint64 acted_tick = 0, acted_ns = 0, written_ns = 0, commands = 0, on_time = 0, late = 0, lost = 0;
+  Uint64 reversals = 0, reversals_taken = 0;
+  double to_command_us = 0, waiting_us = 0; /* sums, for means finer than the percentiles' ms */
+  bool acted = false, acked = true, reversing = false;
+  Point ahead;
+  Direction d = NORTH; /* the last command, which a reversal check reads on the next snapshot */
+
+  if (!_share_path(name, path))
+    return -1;
+  fd = shm_open(path, O_RDWR, 0);
+  if (fd < 0) {
+    fprintf(stderr, "[error]: Could not open shared memory %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SharedState)) {
+    fprintf(stderr, "[error]: %s is not a game's shared state\n", path);
+    close(fd);
+    return -1;
+  }
+  region = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (region == MAP_FAILED) {
+    fprintf(stderr, "[error]: Could not map shared memory %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+  r = region;
+  if (memcmp(r->magic, "SNKS", 4) != 0 || r->version != SHARE_VERSION
+      || (size_t)st.st_size != _share_region_size(r->width, r->height)) {
+    fprintf(stderr, "[error]: %s is not a game's shared state, or from another version\n", path);
+    munmap(region, (size_t)st.st_size);
+    return -1;
+  }
+
+  /* just enough of a game for policy_greedy: the board, the head, the direction and the food */
+  arena = arena_create(sizeof(Snake) + r->occupancy_words * sizeof(Uint64) + 2 * ARENA_ALIGNMENT);
+  if (arena == NULL) {
+    munmap(region, (size_t)st.st_size);
+    return -1;
+  }
+  s = arena_alloc(arena, sizeof(Snake));
+  s->occupancy = arena_alloc(arena, r->occupancy_words * sizeof(Uint64));
+  s->width = r->width;
+  s->height = r->height;
+  s->cell_count = r->width * r->height;
+  memset(&state, 0, sizeof(state));
+  state.snake = s;
+  memset(&to_command, 0, sizeof(to_command));
+  memset(&to_applied, 0, sizeof(to_applied));
+  fprintf(stdout, "[info]: steering the game in %s, a %ux%u board\n", path, r->width, r->height);
+
+  while (SDL_AtomicGet(&r->open) && (max_commands == 0 || commands < max_commands)) {
+    sequence = SDL_AtomicGet(&r->sequence);
+    if (sequence == last_sequence || (sequence & 1)) {
+      sched_yield();
+      continue;
+    }
+    _share_read(r, &view, s->occupancy);
+    last_sequence = sequence;
+
+    /* the ack comes with the snapshot of the tick the command was applied on */
+    if (!acked && view.command_applied == number) {
+      latency_record(&to_applied, (double)(view.command_ns - acted_ns) / 1000000.0);
+      waiting_us += (double)(view.command_ns - written_ns) / 1000.0;
+      if (view.command_tick == acted_tick + 1)
+	on_time++;
+      else
+	late++;
+      /* a refused reversal leaves the snake going the way it was: straight on was free, so on
+       * time it is also alive */
+      if (reversing && (view.is_alive ? view.direction == d : view.command_tick == acted_tick + 1))
+	reversals_taken++;
+      acked = true;
+    }
+    if (!view.is_alive || view.has_won || view.is_paused || (acted && view.tick == acted_tick))
+      continue;
+
+    s->head_position.x = view.head_x;
+    s->head_position.y = view.head_y;
+    s->direction = (Direction)view.direction;
+    state.food.x = view.food_x;
+    state.food.y = view.food_y;
+    d = policy_greedy(&state);
+    reversing = (commands + 1) % SHARE_BOT_REVERSAL_EVERY == 0
+      && point_step(&(s->head_position), s->direction, s->width, s->height, &ahead)
+      && !is_point_occupied(&ahead, s);
+    if (reversing) {
+      d = direction_opposite(s->direction);
+      reversals++;
+    }
+
+    /* a command still waiting for the game is replaced, and never acknowledged */
+    if (!acked)
+      lost++;
+    number++;
+    SDL_AtomicSet(&r->command, (int)((number << 2) | (Uint32)d));
+    written_ns = _share_now_ns();
+    latency_record(&to_command, (double)(written_ns - view.publish_ns) / 1000000.0);
+    to_command_us += (double)(written_ns - view.publish_ns) / 1000.0;
+    acted = true;
+    acked = false;
+    acted_tick = view.tick;
+    acted_ns = view.publish_ns;
+    commands++;
+  }
+
+  fprintf(stdout, "[info]: %llu commands, %llu applied on the next tick, %llu later, %llu replaced%s\n",
+	  (unsigned long long)commands, (unsigned long long)on_time, (unsigned long long)late,
+	  (unsigned long long)lost, SDL_AtomicGet(&r->open) ? "" : "; the game exited");
+  latency_report(&to_command, "publish to command");
+  latency_report(&to_applied, "publish to applied");
+  if (commands > 0 && on_time + late > 0)
+    fprintf(stdout, "[info]: mean publish to command %.1f us, then %.1f us waiting for the next tick\n",
+	    to_command_us / commands, waiting_us / (on_time + late));
+  if (reversals_taken > 0)
+    fprintf(stderr, "[error]: the game turned back on %llu of %llu reversals\n",
+	    (unsigned long long)reversals_taken, (unsigned long long)reversals);
+  else
+    fprintf(stdout, "[info]: %llu reversals sent, all ignored\n", (unsigned long long)reversals);
+  arena_destroy(arena);
+  munmap(region, (size_t)st.st_size);
+  return reversals_taken > 0 ? -1 : 0;
+}
@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "types.h"
+#include "constants.h"
+
+/* set in snapshot_middle while it holds a snapshot the renderer has not picked up */
+#define SNAPSHOT_FRESH 4
+#define SNAPSHOT_INDEX 3
+
+/* arena.c functions */
+void * arena_alloc(Arena *a, size_t size);
+
+/* update.c functions */
+void update(GameState *state, Uint64 elapsed);
+Sint64 update_time_to_next_tick(GameState *state);
+
+/* share.c functions */
+void share_publish(Share *share, GameState *state);
+
+/* wake the main loop, which sleeps in SDL_WaitEvent until something changes; one event is
+ * enough however many snapshots come in before it gets round to the newest */
+void _sim_notify(GameState *state)
+{
+  SDL_Event e;
+
+  if (state->snapshot_event == (Uint32)-1 || !SDL_AtomicCAS(&(state->snapshot_event_pending), 0, 1))
+    return;
+  SDL_zero(e);
+  e.type = state->snapshot_event;
+  if (SDL_PushEvent(&e) != 1)
+    SDL_AtomicSet(&(state->snapshot_event_pending), 0);
+}
+
+/* copy the game into the back buffer and swap it into the middle. The renderer never sees a
+ * snapshot being written: the back buffer is only ever touched by this thread */
+void _sim_publish(GameState *state)
+{
+  Snapshot *s = state->snapshots + state->snapshot_back;
+  Snake *snake = state->snake;
+
+  memcpy(s->occupancy, snake->occupancy, OCCUPANCY_WORDS_FOR(snake->cell_count) * sizeof(Uint64));
+  s->head = snake->head_position;
+  s->food = state->food;
+  s->direction = snake->direction;
+  s->tick = state->tick;
+  s->game = state->games;
+  s->score = state->score;
+  s->length = snake->length;
+  s->play_seconds = (Uint32)(state->play_time / SDL_GetPerformanceFrequency());
+  s->move_delay_ms = snake->move_delay_ms;
+  s->is_alive = snake->is_alive;
+  s->has_won = snake->has_won;
+  s->is_paused = state->is_paused;
+  /* the snapshot has to be complete before the renderer can swap it out */
+  SDL_MemoryBarrierRelease();
+  state->snapshot_back = SDL_AtomicSet(&(state->snapshot_middle), state->snapshot_back | SNAPSHOT_FRESH) & SNAPSHOT_INDEX;
+  _sim_notify(state);
+}
+
+/* the newest published snapshot, without blocking; the previous one if nothing new came in */
+const Snapshot * sim_acquire_snapshot(GameState *state)
+{
+  /* snapshots published from here on need a new wake-up */
+  SDL_AtomicSet(&(state->snapshot_event_pending), 0);
+  if (SDL_AtomicGet(&(state->snapshot_middle)) & SNAPSHOT_FRESH) {
+    state->snapshot_front = SDL_AtomicSet(&(state->snapshot_middle), state->snapshot_front) & SNAPSHOT_INDEX;
+    SDL_MemoryBarrierAcquire();
+  }
+  return state->snapshots + state->snapshot_front;
+}
+
+/* the snapshot the renderer last picked up */
+const Snapshot * sim_current_snapshot(GameState *state)
+{
+  return state->snapshots + state->snapshot_front;
+}
+
+/* P / Space from the main thread: restart a finished game, otherwise toggle pause */
+void sim_press_pause(GameState *state)
+{
+  SDL_AtomicAdd(&(state->pause_presses), 1);
+  SDL_SemPost(state->sim_wake);
+}
+
+void _sim_apply_pause_presses(GameState *state)
+{
+  int presses = SDL_AtomicSet(&(state->pause_presses), 0);
+
+  for (int i = 0; i < presses; i++) {
+    if (state->snake->is_alive == false || state->snake->has_won)
+      state->snake->should_reset = true;
+    else
+      state->is_paused = !state->is_paused;
+  }
+  /* the pause is part of the shared state; a restart is published by update once it happens */
+  if (presses > 0 && state->share != NULL)
+    share_publish(state->share, state);
+}
+
+/* sleep until the deadline like the frame loop does, but wake early if the main thread posts */
+void _sim_wait_until(GameState *state, Uint64 deadline)
+{
+  Uint64 now, remaining_ms;
+
+  while ((now = SDL_GetPerformanceCounter()) < deadline) {
+    remaining_ms = (deadline - now) * 1000 / SDL_GetPerformanceFrequency();
+    if (remaining_ms > 1 && SDL_SemWaitTimeout(state->sim_wake, (Uint32)(remaining_ms - 1)) == 0)
+      return;
+  }
+}
+
+/* the simulation runs on its own clock: it sleeps until the next tick is due and runs it, so a
+ * slow frame or a stalled present on the main thread can't hold a tick back */
+int _sim_thread(void *data)
+{
+  GameState *state = data;
+  Uint64 previous = SDL_GetPerformanceCounter(), now;
+  Sint64 wait;
+
+  while (SDL_AtomicGet(&(state->sim_running))) {
+    now = SDL_GetPerformanceCounter();
+    _sim_apply_pause_presses(state);
+    update(state, now - previous);
+    previous = now;
+    _sim_publish(state);
+
+    wait = update_time_to_next_tick(state);
+    if (wait < 0) {
+      /* paused or over: nothing happens until a key press, and the wait doesn't count as play */
+      SDL_SemWait(state->sim_wake);
+      previous = SDL_GetPerformanceCounter();
+    } else if (wait > 0) {
+      _sim_wait_until(state, now + (Uint64)wait);
+    }
+  }
+  return 0;
+}
+
+/* arena bytes sim_start needs for the snapshots of a width x height board */
+size_t sim_arena_size(unsigned int width, unsigned int height)
+{
+  return 3 * (OCCUPANCY_WORDS_FOR((size_t)width * height) * sizeof(Uint64) + ARENA_ALIGNMENT);
+}
+
+/* publish the first snapshot and start the simulation thread; the game must already be reset */
+/* the snapshots' bitsets come out of the game's arena, sized by sim_arena_size */
+bool sim_start(GameState *state)
+{
+  size_t occupancy_size = OCCUPANCY_WORDS_FOR(state->snake->cell_count) * sizeof(Uint64);
+
+  for (int i = 0; i < 3; i++) {
+    state->snapshots[i].occupancy = arena_alloc(state->arena, occupancy_size);
+    if (state->snapshots[i].occupancy == NULL) {
+      fprintf(stderr, "[error]: Could not allocate memory for the snapshots\n");
+      return false;
+    }
+  }
+  state->snapshot_event = SDL_RegisterEvents(1);
+  if (state->snapshot_event == (Uint32)-1)
+    fprintf(stderr, "[error]: %s, the game loop will poll\n", SDL_GetError());
+  state->snapshot_back = 0;
+  SDL_AtomicSet(&(state->snapshot_middle), 1);
+  state->snapshot_front = 2;
+  _sim_publish(state);
+  sim_acquire_snapshot(state);
+
+  state->sim_wake = SDL_CreateSemaphore(0);
+  if (state->sim_wake == NULL) {
+    fprintf(stderr, "[error]: %s\n", SDL_GetError());
+    return false;
+  }
+  SDL_AtomicSet(&(state->sim_running), 1);
+  state->sim_thread = SDL_CreateThread(_sim_thread, "simulation", state);
+  if (state->sim_thread == NULL) {
+    fprintf(stderr, "[error]: %s\n", SDL_GetError());
+    SDL_AtomicSet(&(state->sim_running), 0);
+    return false;
+  }
+  return true;
+}
+
+void sim_stop(GameState *state)
+{
+  if (state->sim_thread != NULL) {
+    SDL_AtomicSet(&(state->sim_running), 0);
+    SDL_SemPost(state->sim_wake);
+    SDL_WaitThread(state->sim_thread, NULL);
+    state->sim_thread = NULL;
+  }
+  if (state->sim_wake != NULL) {
+    SDL_DestroySemaphore(state->sim_wake);
+    state->sim_wake = NULL;
+  }
+}
@@ -1,57 +1,318 @@
 #include <stdlib.h>
 #include <stdio.h>
-#include <SDL2/SDL.h>
+#include <string.h>
+#include <stdbool.h>
 
 #include "constants.h"
 #include "types.h"
 
 #define SNAKE_INITIAL_LENGTH 4
-#define SNAKE_INITIAL_BUFFER_MULTIPLE 64
 #define SNAKE_INITIAL_MOVE_DELAY_MS 500
+/* queries per body length in snake_lookup_bench; the body walk gets as many as visit about
+ * SNAKE_BENCH_WALK_SEGMENTS segments, since it takes time in proportion to the length */
+#define SNAKE_BENCH_QUERIES (1 << 22)
+#define SNAKE_BENCH_WALK_SEGMENTS (1 << 26)
 
+/* arena.c functions */
+Arena * arena_create(size_t size);
+void * arena_alloc(Arena *a, size_t size);
+void arena_destroy(Arena *a);
 
+/* logic.c functions */
+bool is_point_in_snake(Point *p, Snake *s);
+bool is_point_occupied(Point *p, Snake *s);
 
-Snake * snake_initialize(void)
+/* rng.c functions */
+void rng_seed(Rng *r, Uint64 seed, Uint64 stream);
+Uint32 rng_below(Rng *r, Uint32 bound);
+
+
+/* occupancy bitset and free cell list helpers, kept in step with the head and tail of the body */
+void _snake_set_occupied(Snake *s, SnakeSegment *seg)
+{
+  unsigned int cell = seg->y * s->width + seg->x;
+  unsigned int slot = s->free_cell_slot[cell];
+  unsigned int last = s->free_cells[--s->free_cell_count];
+
+  s->occupancy[cell / 64] |= (Uint64)1 << (cell % 64);
+  /* move the last free cell into the hole left by this one */
+  s->free_cells[slot] = last;
+  s->free_cell_slot[last] = slot;
+}
+
+void _snake_clear_occupied(Snake *s, SnakeSegment *seg)
+{
+  unsigned int cell = seg->y * s->width + seg->x;
+
+  s->occupancy[cell / 64] &= ~((Uint64)1 << (cell % 64));
+  s->free_cell_slot[cell] = s->free_cell_count;
+  s->free_cells[s->free_cell_count++] = cell;
+}
+
+/* the move ring's size for a board of cells cells: the smallest power of two that holds them,
+ * and at least four, a whole byte of moves */
+unsigned int _snake_move_capacity(unsigned int cells)
+{
+  unsigned int capacity = 4;
+
+  while (capacity < cells)
+    capacity <<= 1;
+  return capacity;
+}
+
+/* direction of move i of the ring, 2 bits at a time with move 0 in the low bits of moves[0] */
+Direction _snake_move(const Snake *s, unsigned int i)
+{
+  return (Direction)((s->moves[i / 4] >> (i % 4 * 2)) & 3);
+}
+
+void _snake_set_move(Snake *s, unsigned int i, Direction d)
 {
-  Snake *s = NULL;
-  s = malloc(sizeof(Snake));
+  Uint8 *byte = s->moves + i / 4;
+
+  *byte = (Uint8)((*byte & ~(3u << (i % 4 * 2))) | ((unsigned int)d << (i % 4 * 2)));
+}
+
+/* the cell next to seg in direction d; the body never leaves the board, so there are no checks.
+ * Comparisons instead of a switch, since d is whatever the player did and a jump on it mispredicts */
+void _snake_step(SnakeSegment *seg, Direction d)
+{
+  seg->x += (unsigned int)(d == EAST) - (unsigned int)(d == WEST);
+  seg->y += (unsigned int)(d == SOUTH) - (unsigned int)(d == NORTH);
+}
+
+/* bytes of a width x height snake's body, its move ring, out of snake_arena_size */
+size_t snake_body_size(unsigned int width, unsigned int height)
+{
+  return _snake_move_capacity(width * height) / 4;
+}
+
+/* arena bytes snake_create needs for a width x height board, for sizing the arena */
+size_t snake_arena_size(unsigned int width, unsigned int height)
+{
+  size_t cells = (size_t)width * height;
+
+  return sizeof(Snake) + snake_body_size(width, height)
+    + OCCUPANCY_WORDS_FOR(cells) * sizeof(Uint64) + 2 * cells * sizeof(unsigned int) + 5 * ARENA_ALIGNMENT;
+}
+
+/* allocate the snake, a move ring big enough for the whole board and the cell bookkeeping,
+ * once; games are started by snake_initialize, which reuses the memory */
+Snake * snake_create(Arena *a, unsigned int width, unsigned int height)
+{
+  Snake *s = arena_alloc(a, sizeof(Snake));
   if (s == NULL) {
     fprintf(stderr, "[error]: Failed to allocate memory for Snake\n");
     return NULL;
   }
-  s->segments = malloc(SNAKE_INITIAL_BUFFER_MULTIPLE * sizeof(SnakeSegment));
-  if (s->segments == NULL) {
-    fprintf(stderr, "[error]: Failed to allocate memory for SnakeSegments\n");
+  s->width = width;
+  s->height = height;
+  s->cell_count = width * height;
+  s->move_capacity = _snake_move_capacity(s->cell_count);
+  s->moves = arena_alloc(a, s->move_capacity / 4);
+  if (s->moves == NULL) {
+    fprintf(stderr, "[error]: Failed to allocate memory for the Snake's moves\n");
+    return NULL;
+  }
+  s->occupancy = arena_alloc(a, OCCUPANCY_WORDS_FOR(s->cell_count) * sizeof(Uint64));
+  s->free_cells = arena_alloc(a, s->cell_count * sizeof(unsigned int));
+  s->free_cell_slot = arena_alloc(a, s->cell_count * sizeof(unsigned int));
+  if (s->occupancy == NULL || s->free_cells == NULL || s->free_cell_slot == NULL) {
+    fprintf(stderr, "[error]: Failed to allocate memory for the Snake's board\n");
     return NULL;
   }
+  return s;
+}
+
+/* put the snake back at the start of a game, in place */
+void snake_initialize(Snake *s)
+{
+  SnakeSegment seg = {0, s->height / 2};
 
   s->length = SNAKE_INITIAL_LENGTH;
-  s->segment_buffer_size = SNAKE_INITIAL_BUFFER_MULTIPLE * sizeof(SnakeSegment);
-  s->direction = EAST;
-  s->direction_queued = EAST;
+  s->tail = 0;
+  s->head = SNAKE_INITIAL_LENGTH - 1;
+  s->direction = SNAKE_INITIAL_DIRECTION;
+  s->direction_queued = SNAKE_INITIAL_DIRECTION;
   s->move_delay_ms = SNAKE_INITIAL_MOVE_DELAY_MS;
-  s->last_move_ms = SDL_GetTicks64() + SNAKE_INITIAL_MOVE_DELAY_MS;
   s->is_alive = true;
+  s->has_won = false;
   s->should_reset = false;
   
-  /* set the initial snake segments */
+  /* every cell starts out free */
+  memset(s->occupancy, 0, OCCUPANCY_WORDS_FOR(s->cell_count) * sizeof(Uint64));
+  for (unsigned int cell = 0; cell < s->cell_count; cell++) {
+    s->free_cells[cell] = cell;
+    s->free_cell_slot[cell] = cell;
+  }
+  s->free_cell_count = s->cell_count;
+
+  /* lay the initial snake out eastwards, tail first */
+  s->tail_position = seg;
   for (int i = 0; i < SNAKE_INITIAL_LENGTH; i++) {
-    (s->segments + i)->x = SNAKE_INITIAL_LENGTH - i - 1;
-    (s->segments + i)->y = GRID_COUNT_Y / 2;
+    _snake_set_occupied(s, &seg);
+    if (i + 1 < SNAKE_INITIAL_LENGTH) {
+      _snake_set_move(s, i, EAST);
+      _snake_step(&seg, EAST);
+    }
   }
-  return s;
+  s->head_position = seg;
 }
 
-void snake_deinitialize(Snake *s)
+/* move the head one cell in direction d, which the caller has checked is free; the tail is
+ * left in place, so the snake is one segment longer. The ring holds every cell of the board,
+ * so it is never full */
+void snake_push_head(Snake *s, Direction d)
 {
-  if (s == NULL) {
-    fprintf(stderr, "[error]: Tried to deallocate NULL Snake pointer\n");
-    return;
+  _snake_set_move(s, s->head, d);
+  s->head = (s->head + 1) & (s->move_capacity - 1);
+  _snake_step(&(s->head_position), d);
+  _snake_set_occupied(s, &(s->head_position));
+  s->length++;
+}
+
+/* drop the tail segment, following the oldest move to the new tail */
+void snake_pop_tail(Snake *s)
+{
+  _snake_clear_occupied(s, &(s->tail_position));
+  _snake_step(&(s->tail_position), _snake_move(s, s->tail));
+  s->tail = (s->tail + 1) & (s->move_capacity - 1);
+  s->length--;
+}
+
+/* start a walk along s from its tail; snake_iterate_next then returns every segment in turn */
+void snake_iterate(const Snake *s, SnakeIterator *it)
+{
+  it->snake = s;
+  it->position = s->tail_position;
+  it->move = s->tail;
+  it->remaining = s->length;
+}
+
+/* the next segment of the walk into seg, towards the head; false once past the head */
+bool snake_iterate_next(SnakeIterator *it, SnakeSegment *seg)
+{
+  if (it->remaining == 0)
+    return false;
+  *seg = it->position;
+  if (--it->remaining > 0) {
+    _snake_step(&(it->position), _snake_move(it->snake, it->move));
+    it->move = (it->move + 1) & (it->snake->move_capacity - 1);
   }
-  if (s->segments == NULL) {
-    fprintf(stderr, "[error]: Tried to deallocate NULL Snake->segments pointer\n");
-    return;
+  return true;
+}
+
+/* put the snake back into a recorded position, e.g. a replay keyframe: body lists its cells
+ * from tail to head, each next to the one before, free_cells the rest of the board in free
+ * list order. The order matters, since food is drawn by position in the free list. Either may
+ * be the snake's own free_cells or free_cell_slot, body is read before the slots are rebuilt.
+ * Returns false if two cells of body aren't neighbours */
+bool snake_restore(Snake *s, const Uint32 *body, unsigned int length, const Uint32 *free_cells,
+		   unsigned int free_cell_count)
+{
+  Direction d;
+
+  memset(s->occupancy, 0, OCCUPANCY_WORDS_FOR(s->cell_count) * sizeof(Uint64));
+  for (unsigned int i = 0; i < length; i++) {
+    s->occupancy[body[i] / 64] |= (Uint64)1 << (body[i] % 64);
+    if (i + 1 == length)
+      break;
+    if (body[i + 1] + s->width == body[i])
+      d = NORTH;
+    else if (body[i] + s->width == body[i + 1])
+      d = SOUTH;
+    else if (body[i] + 1 == body[i + 1] && body[i + 1] % s->width != 0)
+      d = EAST;
+    else if (body[i + 1] + 1 == body[i] && body[i] % s->width != 0)
+      d = WEST;
+    else
+      return false;
+    _snake_set_move(s, i, d);
+  }
+  s->tail_position.x = body[0] % s->width;
+  s->tail_position.y = body[0] / s->width;
+  s->head_position.x = body[length - 1] % s->width;
+  s->head_position.y = body[length - 1] / s->width;
+  s->tail = 0;
+  s->head = (length - 1) & (s->move_capacity - 1);
+  s->length = length;
+  for (unsigned int i = 0; i < free_cell_count; i++) {
+    s->free_cells[i] = free_cells[i];
+    s->free_cell_slot[free_cells[i]] = i;
+  }
+  s->free_cell_count = free_cell_count;
+  s->should_reset = false;
+  return true;
+}
+
+/* time the board lookups of a width x height game at body lengths 4, 100 and the whole board
+ * but one cell: is_point_occupied on random cells, drawing a random free cell as food
+ * placement does, and for comparison is_point_in_snake, the walk along the body. The first
+ * two should cost the same at any length */
+int snake_lookup_bench(unsigned int width, unsigned int height, Uint64 seed)
+{
+  unsigned int cells = width * height, lengths[3] = {4, 100, cells - 1};
+  Arena *arena = arena_create(snake_arena_size(width, height) + cells * sizeof(Uint32) + ARENA_ALIGNMENT);
+  Uint32 *path;
+  Snake *s;
+  Rng rng;
+  Point p;
+  Uint64 start, hits = 0;
+  double occupied_ns, free_ns, walk_ns;
+  unsigned int cell, walks;
+
+  if (arena == NULL)
+    return -1;
+  path = arena_alloc(arena, cells * sizeof(Uint32));
+  s = snake_create(arena, width, height);
+  if (path == NULL || s == NULL) {
+    arena_destroy(arena);
+    return -1;
+  }
+  /* the body snakes along the rows from the top left, left to right and back */
+  for (unsigned int y = 0; y < height; y++)
+    for (unsigned int x = 0; x < width; x++)
+      path[y * width + x] = y * width + (y % 2 == 0 ? x : width - 1 - x);
+  rng_seed(&rng, seed, 0);
+
+  for (int i = 0; i < 3; i++) {
+    if (lengths[i] >= cells || (i > 0 && lengths[i] <= lengths[i - 1]))
+      continue;
+    snake_restore(s, path, lengths[i], path + lengths[i], cells - lengths[i]);
+
+    start = SDL_GetPerformanceCounter();
+    for (unsigned int q = 0; q < SNAKE_BENCH_QUERIES; q++) {
+      cell = rng_below(&rng, cells);
+      p.x = cell % width;
+      p.y = cell / width;
+      hits += is_point_occupied(&p, s);
+    }
+    occupied_ns = (double)(SDL_GetPerformanceCounter() - start) * 1e9 / SDL_GetPerformanceFrequency()
+      / SNAKE_BENCH_QUERIES;
+
+    start = SDL_GetPerformanceCounter();
+    for (unsigned int q = 0; q < SNAKE_BENCH_QUERIES; q++)
+      hits += s->free_cells[rng_below(&rng, s->free_cell_count)];
+    free_ns = (double)(SDL_GetPerformanceCounter() - start) * 1e9 / SDL_GetPerformanceFrequency()
+      / SNAKE_BENCH_QUERIES;
+
+    walks = SNAKE_BENCH_WALK_SEGMENTS / lengths[i];
+    start = SDL_GetPerformanceCounter();
+    for (unsigned int q = 0; q < walks; q++) {
+      cell = rng_below(&rng, cells);
+      p.x = cell % width;
+      p.y = cell / width;
+      hits += is_point_in_snake(&p, s);
+    }
+    walk_ns = (double)(SDL_GetPerformanceCounter() - start) * 1e9 / SDL_GetPerformanceFrequency()
+      / walks;
+
+    fprintf(stdout, "[info]: length %u on %ux%u: occupied %.1f ns, free cell %.1f ns, body walk %.1f ns per query\n",
+	    lengths[i], width, height, occupied_ns, free_ns, walk_ns);
   }
-  free(s->segments);
-  free(s);
+  /* hits only keeps the lookups from being optimized away */
+  if (hits == 0)
+    fprintf(stdout, "[info]: no lookups hit\n");
+  arena_destroy(arena);
+  return 0;
 }
@@ -0,0 +1,449 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <SDL2/SDL.h>
+
+#include "types.h"
+#include "constants.h"
+
+/* arena mode: thousands of bot snakes and their food share one big board. A tick has two
+ * parallel phases over contiguous ranges of snakes and one short serial phase:
+ *   move:    each snake picks a direction and looks up the cell ahead in owner; walls and
+ *            bodies (tails included, as in the single game) kill it, otherwise it claims the cell
+ *   resolve: a snake that was the only one to claim its cell moves in, eating any food there;
+ *            when two or more heads claim the same cell they all die. Bodies of the dead are
+ *            cleared from the board
+ *   respawn: eaten food and dead snakes are put back at random empty cells, in snake order
+ * Neither parallel phase writes anything the other snakes read in that phase, and the serial
+ * phase runs in a fixed order, so the outcome doesn't depend on the number of threads */
+
+#define SWARM_MAX_LENGTH 32 /* body ring per snake, a power of two; a snake grows to this length
+			     * and after that eating only scores */
+#define SWARM_CELLS_PER_SNAKE 64 /* board area per snake */
+#define SWARM_FOOD_PER_SNAKE 2
+#define SWARM_SPAWN_ATTEMPTS 32
+#define SWARM_MAX_THREADS 256
+#define SWARM_FOOD 0xffffffffu
+#define SWARM_NO_CELL 0xffffffffu
+#define SWARM_CONTESTED -1 /* claim value once a second snake has claimed a cell */
+
+/* arena.c functions */
+Arena * arena_create(size_t size);
+void * arena_alloc(Arena *a, size_t size);
+void arena_destroy(Arena *a);
+
+/* rng.c functions */
+void rng_seed(Rng *r, Uint64 seed, Uint64 stream);
+Uint32 rng_below(Rng *r, Uint32 bound);
+
+typedef enum {
+  SWARM_PHASE_MOVE,
+  SWARM_PHASE_RESOLVE,
+  SWARM_PHASE_EXIT
+} SwarmPhase;
+
+typedef struct SwarmPool SwarmPool;
+
+/* a thread and its range of snakes; ate and died list, in id order, the snakes of the range
+ * that need the serial respawn phase this tick */
+typedef struct {
+  SwarmPool *pool;
+  SDL_Thread *thread;
+  SDL_sem *start;
+  unsigned int first;
+  unsigned int last;
+  Uint32 *ate;
+  unsigned int ate_count;
+  Uint32 *died;
+  unsigned int died_count;
+  Uint64 moves;
+  Uint64 eats;
+  Uint64 deaths;
+  char padding[CACHE_LINE_SIZE];
+} SwarmWorker;
+
+struct SwarmPool {
+  Swarm *swarm;
+  SwarmWorker *workers;
+  int worker_count;
+  SwarmPhase phase;
+  SDL_sem *done;
+};
+
+/* a cheap deterministic hash of snake and tick, for the bots' wandering */
+Uint32 _swarm_hash(Uint32 id, Uint64 tick)
+{
+  Uint32 h = id * 0x9e3779b1u ^ (Uint32)tick * 0x85ebca6bu;
+  h ^= h >> 15;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 13;
+  return h;
+}
+
+/* the cell one step from cell in direction d, or SWARM_NO_CELL off the board */
+Uint32 _swarm_step(Swarm *s, Uint32 cell, unsigned int d)
+{
+  unsigned int x = cell % s->width, y = cell / s->width;
+
+  switch (d) {
+  case NORTH:
+    return y > 0 ? cell - s->width : SWARM_NO_CELL;
+  case SOUTH:
+    return y + 1 < s->height ? cell + s->width : SWARM_NO_CELL;
+  case EAST:
+    return x + 1 < s->width ? cell + 1 : SWARM_NO_CELL;
+  default:
+    return x > 0 ? cell - 1 : SWARM_NO_CELL;
+  }
+}
+
+/* straight on or one of the two turns: food first, then any empty cell, wandering now and then.
+ * Directions are NORTH 0, SOUTH 1, EAST 2, WEST 3, so the turns from d are d < 2 ? 2, 3 : 0, 1 */
+unsigned int _swarm_policy(Swarm *s, Uint32 id, Uint32 head)
+{
+  unsigned int d = s->direction[id];
+  unsigned int turn = d < 2 ? 2 : 0;
+  Uint32 h = _swarm_hash(id, s->tick);
+  unsigned int candidates[3] = {d, turn + (h & 1), turn + 1 - (h & 1)};
+  Uint32 cell;
+
+  if ((h & 0x70) == 0) {
+    candidates[0] = candidates[1];
+    candidates[1] = d;
+  }
+  for (int i = 0; i < 3; i++) {
+    cell = _swarm_step(s, head, candidates[i]);
+    if (cell != SWARM_NO_CELL && s->owner[cell] == SWARM_FOOD)
+      return candidates[i];
+  }
+  for (int i = 0; i < 3; i++) {
+    cell = _swarm_step(s, head, candidates[i]);
+    if (cell != SWARM_NO_CELL && s->owner[cell] == 0)
+      return candidates[i];
+  }
+  return d;
+}
+
+/* phase 1: choose a move, and claim the cell ahead unless it is a wall or a body */
+void _swarm_move(Swarm *s, SwarmWorker *w)
+{
+  for (unsigned int i = w->first; i < w->last; i++) {
+    Uint32 head, cell;
+    unsigned int d;
+
+    if (!s->alive[i])
+      continue;
+    head = s->body[i * SWARM_MAX_LENGTH + s->body_head[i]];
+    d = _swarm_policy(s, i, head);
+    s->direction[i] = (Uint8)d;
+    cell = _swarm_step(s, head, d);
+    if (cell != SWARM_NO_CELL && s->owner[cell] != 0 && s->owner[cell] != SWARM_FOOD)
+      cell = SWARM_NO_CELL;
+    s->target[i] = cell;
+    /* the first claim wins the cell for now; any later one marks it contested for everybody */
+    if (cell != SWARM_NO_CELL && !SDL_AtomicCAS(s->claims + cell, 0, (int)(i + 1)))
+      SDL_AtomicSet(s->claims + cell, SWARM_CONTESTED);
+  }
+}
+
+/* phase 2: move the snakes that hold their claim, kill the rest. Taking the claim also clears
+ * it for the next tick; a contested cell reads as contested or cleared to every claimant, and
+ * only a lone claimant ever reads its own id back */
+void _swarm_resolve(Swarm *s, SwarmWorker *w)
+{
+  w->ate_count = 0;
+  w->died_count = 0;
+  for (unsigned int i = w->first; i < w->last; i++) {
+    Uint32 *body = s->body + i * SWARM_MAX_LENGTH;
+    Uint32 cell = s->target[i];
+    bool ate;
+
+    if (!s->alive[i])
+      continue;
+    if (cell == SWARM_NO_CELL || SDL_AtomicSet(s->claims + cell, 0) != (int)(i + 1)) {
+      for (Uint32 k = 0; k < s->length[i]; k++)
+	s->owner[body[(s->body_tail[i] + k) & (SWARM_MAX_LENGTH - 1)]] = 0;
+      s->alive[i] = 0;
+      w->died[w->died_count++] = i;
+      w->deaths++;
+      continue;
+    }
+    ate = s->owner[cell] == SWARM_FOOD;
+    /* drop the tail first: in a full ring the new head takes the tail's slot */
+    if (ate && s->length[i] < SWARM_MAX_LENGTH) {
+      s->length[i]++;
+    } else {
+      s->owner[body[s->body_tail[i]]] = 0;
+      s->body_tail[i] = (s->body_tail[i] + 1) & (SWARM_MAX_LENGTH - 1);
+    }
+    s->owner[cell] = i + 1;
+    s->body_head[i] = (s->body_head[i] + 1) & (SWARM_MAX_LENGTH - 1);
+    body[s->body_head[i]] = cell;
+    if (ate) {
+      s->score[i]++;
+      w->ate[w->ate_count++] = i;
+      w->eats++;
+    }
+    w->moves++;
+  }
+}
+
+/* a random empty cell: a few random tries, then on a crowded board the first empty cell from
+ * a random start, so only a full board gives SWARM_NO_CELL */
+Uint32 _swarm_random_empty_cell(Swarm *s)
+{
+  Uint32 cells = s->width * s->height, cell;
+
+  for (int attempt = 0; attempt < SWARM_SPAWN_ATTEMPTS; attempt++) {
+    cell = rng_below(&(s->rng), cells);
+    if (s->owner[cell] == 0)
+      return cell;
+  }
+  cell = rng_below(&(s->rng), cells);
+  for (Uint32 k = 0; k < cells; k++, cell = cell + 1 < cells ? cell + 1 : 0) {
+    if (s->owner[cell] == 0)
+      return cell;
+  }
+  return SWARM_NO_CELL;
+}
+
+void _swarm_place_food(Swarm *s)
+{
+  Uint32 cell = _swarm_random_empty_cell(s);
+
+  if (cell != SWARM_NO_CELL)
+    s->owner[cell] = SWARM_FOOD;
+}
+
+/* a one cell snake at a random empty cell; only on a full board does it stay dead */
+void _swarm_spawn_snake(Swarm *s, Uint32 id)
+{
+  Uint32 cell = _swarm_random_empty_cell(s);
+
+  if (cell == SWARM_NO_CELL)
+    return;
+  s->owner[cell] = id + 1;
+  s->body_tail[id] = 0;
+  s->body_head[id] = 0;
+  s->body[id * SWARM_MAX_LENGTH] = cell;
+  s->length[id] = 1;
+  s->direction[id] = (Uint8)rng_below(&(s->rng), 4);
+  s->alive[id] = 1;
+}
+
+void swarm_destroy(Swarm *s)
+{
+  if (s != NULL)
+    arena_destroy(s->arena);
+}
+
+/* the board side for count snakes: a square with SWARM_CELLS_PER_SNAKE cells per snake */
+unsigned int _swarm_side(unsigned int count)
+{
+  return (unsigned int)ceil(sqrt((double)count * SWARM_CELLS_PER_SNAKE));
+}
+
+/* bytes of arena for count snakes, their board and a pool of threads workers */
+size_t _swarm_arena_size(unsigned int count, int threads)
+{
+  size_t cells = (size_t)_swarm_side(count) * _swarm_side(count);
+
+  return sizeof(Swarm) + cells * (sizeof(Uint32) + sizeof(SDL_atomic_t))
+    + (size_t)count * (SWARM_MAX_LENGTH + 5) * sizeof(Uint32) + 2 * (size_t)count * sizeof(Uint8)
+    + threads * (sizeof(SwarmWorker) + 2 * ARENA_ALIGNMENT) + 2 * ((size_t)count + threads) * sizeof(Uint32)
+    + 12 * ARENA_ALIGNMENT;
+}
+
+/* a square board with SWARM_CELLS_PER_SNAKE cells per snake, the snakes and their food, all
+ * in one arena with room left for a pool of threads workers */
+Swarm * swarm_create(unsigned int count, int threads, Uint64 seed)
+{
+  Arena *arena = arena_create(_swarm_arena_size(count, threads));
+  Swarm *s;
+  size_t cells;
+
+  if (arena == NULL)
+    return NULL;
+  s = arena_alloc(arena, sizeof(Swarm));
+  s->arena = arena;
+  s->count = count;
+  s->width = _swarm_side(count);
+  s->height = s->width;
+  cells = (size_t)s->width * s->height;
+  s->owner = arena_alloc(arena, cells * sizeof(Uint32));
+  s->claims = arena_alloc(arena, cells * sizeof(SDL_atomic_t));
+  s->body = arena_alloc(arena, (size_t)count * SWARM_MAX_LENGTH * sizeof(Uint32));
+  s->body_head = arena_alloc(arena, count * sizeof(Uint32));
+  s->body_tail = arena_alloc(arena, count * sizeof(Uint32));
+  s->length = arena_alloc(arena, count * sizeof(Uint32));
+  s->score = arena_alloc(arena, count * sizeof(Uint32));
+  s->target = arena_alloc(arena, count * sizeof(Uint32));
+  s->direction = arena_alloc(arena, count * sizeof(Uint8));
+  s->alive = arena_alloc(arena, count * sizeof(Uint8));
+  if (!s->owner || !s->claims || !s->body || !s->body_head || !s->body_tail || !s->length ||
+      !s->score || !s->target || !s->direction || !s->alive) {
+    fprintf(stderr, "[error]: Could not allocate memory for %u snakes\n", count);
+    swarm_destroy(s);
+    return NULL;
+  }
+  rng_seed(&(s->rng), seed, 0);
+  for (unsigned int i = 0; i < count; i++)
+    _swarm_spawn_snake(s, i);
+  for (unsigned int i = 0; i < count * SWARM_FOOD_PER_SNAKE; i++)
+    _swarm_place_food(s);
+  return s;
+}
+
+void _swarm_run_phase(SwarmWorker *w, SwarmPhase phase)
+{
+  if (phase == SWARM_PHASE_MOVE)
+    _swarm_move(w->pool->swarm, w);
+  else
+    _swarm_resolve(w->pool->swarm, w);
+}
+
+int _swarm_worker(void *data)
+{
+  SwarmWorker *w = data;
+
+  for (;;) {
+    SDL_SemWait(w->start);
+    if (w->pool->phase == SWARM_PHASE_EXIT)
+      break;
+    _swarm_run_phase(w, w->pool->phase);
+    SDL_SemPost(w->pool->done);
+  }
+  return 0;
+}
+
+/* run a phase across the pool; the calling thread does worker 0's share. The semaphores order
+ * each phase's writes before the next phase's reads */
+void _swarm_phase(SwarmPool *pool, SwarmPhase phase)
+{
+  pool->phase = phase;
+  for (int i = 1; i < pool->worker_count; i++)
+    SDL_SemPost(pool->workers[i].start);
+  _swarm_run_phase(pool->workers, phase);
+  for (int i = 1; i < pool->worker_count; i++)
+    SDL_SemWait(pool->done);
+}
+
+/* advance every snake by one tick */
+void swarm_step(SwarmPool *pool)
+{
+  Swarm *s = pool->swarm;
+
+  _swarm_phase(pool, SWARM_PHASE_MOVE);
+  _swarm_phase(pool, SWARM_PHASE_RESOLVE);
+  /* serial and in id order, food then snakes: workers hold contiguous, ascending ranges */
+  for (int i = 0; i < pool->worker_count; i++) {
+    for (unsigned int k = 0; k < pool->workers[i].ate_count; k++)
+      _swarm_place_food(s);
+  }
+  for (int i = 0; i < pool->worker_count; i++) {
+    for (unsigned int k = 0; k < pool->workers[i].died_count; k++)
+      _swarm_spawn_snake(s, pool->workers[i].died[k]);
+  }
+  s->tick++;
+}
+
+/* stop the threads; also cleans up after a _swarm_pool_create that failed part way */
+void _swarm_pool_destroy(SwarmPool *pool)
+{
+  pool->phase = SWARM_PHASE_EXIT;
+  for (int i = 0; i < pool->worker_count; i++) {
+    SwarmWorker *w = pool->workers + i;
+    if (w->thread != NULL) {
+      SDL_SemPost(w->start);
+      SDL_WaitThread(w->thread, NULL);
+    }
+    if (w->start != NULL)
+      SDL_DestroySemaphore(w->start);
+  }
+  if (pool->done != NULL)
+    SDL_DestroySemaphore(pool->done);
+}
+
+/* split the snakes into threads contiguous ranges, as many as s was created for; worker 0 runs
+ * on the calling thread */
+bool _swarm_pool_create(SwarmPool *pool, Swarm *s, int threads)
+{
+  pool->swarm = s;
+  pool->worker_count = 0;
+  pool->done = SDL_CreateSemaphore(0);
+  pool->workers = arena_alloc(s->arena, threads * sizeof(SwarmWorker));
+  if (pool->done == NULL || pool->workers == NULL) {
+    fprintf(stderr, "[error]: Could not create the swarm thread pool\n");
+    return false;
+  }
+  for (int i = 0; i < threads; i++) {
+    SwarmWorker *w = pool->workers + i;
+    w->pool = pool;
+    w->first = (unsigned int)((Uint64)s->count * i / threads);
+    w->last = (unsigned int)((Uint64)s->count * (i + 1) / threads);
+    w->ate = arena_alloc(s->arena, (w->last - w->first + 1) * sizeof(Uint32));
+    w->died = arena_alloc(s->arena, (w->last - w->first + 1) * sizeof(Uint32));
+    w->start = i > 0 ? SDL_CreateSemaphore(0) : NULL;
+    pool->worker_count++;
+    if (w->ate == NULL || w->died == NULL || (i > 0 && w->start == NULL)) {
+      fprintf(stderr, "[error]: Could not create the swarm thread pool\n");
+      return false;
+    }
+    if (i > 0 && (w->thread = SDL_CreateThread(_swarm_worker, "swarm", w)) == NULL) {
+      fprintf(stderr, "[error]: %s\n", SDL_GetError());
+      return false;
+    }
+  }
+  return true;
+}
+
+/* run count snakes for ticks ticks on threads threads (0 for one per core) and report
+ * throughput; the checksum of the final board is the same for a seed on any number of threads */
+int swarm_run(unsigned int count, unsigned long ticks, int threads, Uint64 seed)
+{
+  Swarm *s;
+  SwarmPool pool;
+  Uint64 start_counter, moves = 0, eats = 0, deaths = 0, checksum = 0;
+  unsigned int alive = 0;
+  double seconds;
+
+  if (threads <= 0)
+    threads = SDL_GetCPUCount();
+  if (threads > SWARM_MAX_THREADS)
+    threads = SWARM_MAX_THREADS;
+  if ((unsigned int)threads > count)
+    threads = count > 0 ? (int)count : 1;
+
+  if ((s = swarm_create(count, threads, seed)) == NULL)
+    return -1;
+  if (!_swarm_pool_create(&pool, s, threads)) {
+    _swarm_pool_destroy(&pool);
+    swarm_destroy(s);
+    return -1;
+  }
+
+  start_counter = SDL_GetPerformanceCounter();
+  for (unsigned long t = 0; t < ticks; t++)
+    swarm_step(&pool);
+  seconds = (double)(SDL_GetPerformanceCounter() - start_counter) / SDL_GetPerformanceFrequency();
+
+  for (int i = 0; i < pool.worker_count; i++) {
+    moves += pool.workers[i].moves;
+    eats += pool.workers[i].eats;
+    deaths += pool.workers[i].deaths;
+  }
+  for (unsigned int i = 0; i < count; i++) {
+    alive += s->alive[i];
+    checksum = checksum * 31 + s->score[i] * 7 + s->length[i] + s->body[i * SWARM_MAX_LENGTH + s->body_head[i]];
+  }
+  fprintf(stdout, "[info]: swarm of %u snakes on %ux%u, %lu ticks on %d threads in %.3f s "
+	  "(%.0f ticks/s, %.0f snake moves/s)\n",
+	  count, s->width, s->height, ticks, threads, seconds,
+	  seconds > 0 ? ticks / seconds : 0.0, seconds > 0 ? moves / seconds : 0.0);
+  fprintf(stdout, "[info]: %llu food eaten, %llu deaths, %u alive at the end, checksum %016llx\n",
+	  (unsigned long long)eats, (unsigned long long)deaths, alive, (unsigned long long)checksum);
+  _swarm_pool_destroy(&pool);
+  swarm_destroy(s);
+  return 0;
+}
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <SDL2/SDL.h>
+#include "types.h"
+#include "constants.h"
+
+/* arena.c functions */
+void * arena_alloc(Arena *a, size_t size);
+
+const char *_telemetry_phase_names[TELEMETRY_PHASES] = {
+  "process_input", "update", "render", "present"
+};
+
+/* allocate the telemetry from the game's arena; it is always there so F3 can switch it on, but
+ * while disabled the game loop's calls return after a single branch */
+Telemetry * telemetry_initialize(Arena *a, bool enabled, const char *csv_path)
+{
+  Telemetry *t = arena_alloc(a, sizeof(Telemetry));
+
+  if (t == NULL) {
+    fprintf(stderr, "[error]: Could not allocate memory for Telemetry\n");
+    return NULL;
+  }
+  t->enabled = enabled || csv_path != NULL;
+  if (csv_path != NULL) {
+    t->csv = fopen(csv_path, "w");
+    if (t->csv == NULL) {
+      fprintf(stderr, "[error]: Could not open %s for telemetry\n", csv_path);
+      return NULL;
+    }
+    fprintf(t->csv, "frame,input_us,update_us,render_us,present_us\n");
+  }
+  return t;
+}
+
+void telemetry_toggle(Telemetry *t)
+{
+  t->enabled = !t->enabled;
+}
+
+void telemetry_frame_begin(Telemetry *t)
+{
+  t->in_frame = t->enabled;
+  if (!t->in_frame)
+    return;
+  t->mark = SDL_GetPerformanceCounter();
+}
+
+/* time since the previous phase ended is charged to phase */
+void telemetry_phase_end(Telemetry *t, TelemetryPhase phase)
+{
+  Uint64 now;
+
+  if (!t->in_frame)
+    return;
+  now = SDL_GetPerformanceCounter();
+  t->current.phase_us[phase] = (Uint32)((now - t->mark) * 1000000 / SDL_GetPerformanceFrequency());
+  t->mark = now;
+}
+
+/* publish the frame's sample; a full ring means nobody has drained it lately, and the game
+ * loop never waits on the consumer, so the sample is dropped and counted instead */
+void telemetry_frame_end(Telemetry *t)
+{
+  int write, read;
+
+  if (!t->in_frame)
+    return;
+  t->current.frame = t->frame++;
+  t->last = t->current;
+  write = SDL_AtomicGet(&(t->ring_write));
+  read = SDL_AtomicGet(&(t->ring_read));
+  if ((unsigned int)(write - read) >= TELEMETRY_RING_SIZE) {
+    t->dropped++;
+    return;
+  }
+  t->ring[(unsigned int)write & (TELEMETRY_RING_SIZE - 1)] = t->current;
+  /* the sample has to be in the ring before the consumer can see the new write index */
+  SDL_MemoryBarrierRelease();
+  SDL_AtomicSet(&(t->ring_write), write + 1);
+}
+
+/* samples in the ring waiting for telemetry_drain */
+unsigned int telemetry_pending(Telemetry *t)
+{
+  return (unsigned int)(SDL_AtomicGet(&(t->ring_write)) - SDL_AtomicGet(&(t->ring_read)));
+}
+
+/* consume everything in the ring into the histograms, and the CSV file if there is one */
+void telemetry_drain(Telemetry *t)
+{
+  int read = SDL_AtomicGet(&(t->ring_read));
+  int write = SDL_AtomicGet(&(t->ring_write));
+  TelemetrySample *s;
+  unsigned int bucket;
+
+  SDL_MemoryBarrierAcquire();
+  for (; read != write; read++) {
+    s = t->ring + ((unsigned int)read & (TELEMETRY_RING_SIZE - 1));
+    for (int p = 0; p < TELEMETRY_PHASES; p++) {
+      bucket = s->phase_us[p] / TELEMETRY_BUCKET_US;
+      t->histogram[p][bucket < TELEMETRY_BUCKETS ? bucket : TELEMETRY_BUCKETS - 1]++;
+      if (s->phase_us[p] > t->max_us[p])
+	t->max_us[p] = s->phase_us[p];
+    }
+    t->samples++;
+    if (t->csv != NULL)
+      fprintf(t->csv, "%lu,%u,%u,%u,%u\n", (unsigned long)s->frame, s->phase_us[TELEMETRY_INPUT],
+	      s->phase_us[TELEMETRY_UPDATE], s->phase_us[TELEMETRY_RENDER], s->phase_us[TELEMETRY_PRESENT]);
+  }
+  /* the slots are free for the producer once their contents have been read */
+  SDL_MemoryBarrierRelease();
+  SDL_AtomicSet(&(t->ring_read), read);
+}
+
+/* upper edge of the bucket holding the given fraction of the samples, in milliseconds; never
+ * more than the largest sample, which the last bucket's edge can be */
+double _telemetry_percentile(Telemetry *t, int phase, double fraction)
+{
+  Uint64 rank = (Uint64)(t->samples * fraction);
+  Uint64 seen = 0;
+  Uint32 edge_us = t->max_us[phase];
+
+  for (unsigned int b = 0; b + 1 < TELEMETRY_BUCKETS; b++) {
+    seen += t->histogram[phase][b];
+    if (seen > rank) {
+      edge_us = (b + 1) * TELEMETRY_BUCKET_US;
+      break;
+    }
+  }
+  return (edge_us < t->max_us[phase] ? edge_us : t->max_us[phase]) / 1000.0;
+}
+
+void telemetry_report(Telemetry *t)
+{
+  telemetry_drain(t);
+  if (t->samples == 0) {
+    fprintf(stdout, "[info]: telemetry: no samples\n");
+    return;
+  }
+  fprintf(stdout, "[info]: telemetry: %lu frames, %lu dropped\n",
+	  (unsigned long)t->samples, (unsigned long)t->dropped);
+  for (int p = 0; p < TELEMETRY_PHASES; p++)
+    fprintf(stdout, "[info]: telemetry %s: p50 %.2f ms, p99 %.2f ms, max %.2f ms\n", _telemetry_phase_names[p],
+	    _telemetry_percentile(t, p, 0.50), _telemetry_percentile(t, p, 0.99), t->max_us[p] / 1000.0);
+}
+
+void telemetry_deinitialize(Telemetry *t)
+{
+  if (t == NULL)
+    return;
+  if (t->csv != NULL)
+    fclose(t->csv);
+}
@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "types.h"
+#include "constants.h"
+
+/* the menu's score, length, speed and play time. The font is a small bitmap baked into one
+ * atlas at startup; a field is only formatted and laid out into glyph quads when its number
+ * changes, and render.c draws every quad it needs in one submission */
+
+/* the characters of the font in atlas order, TEXT_ATLAS_GLYPHS of them; a space comes first */
+#define TEXT_CHARSET " .:0123456789CDEGHILMNOPRST"
+/* characters before a field's value: its label and at least one space */
+#define TEXT_LABEL_CHARS 7
+
+/* one byte per row, the leftmost column in bit 4 */
+const Uint8 _text_font[TEXT_ATLAS_GLYPHS][TEXT_GLYPH_HEIGHT] = {
+  {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, /* space */
+  {0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c}, /* . */
+  {0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00}, /* : */
+  {0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e}, /* 0 */
+  {0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e}, /* 1 */
+  {0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f}, /* 2 */
+  {0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e}, /* 3 */
+  {0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02}, /* 4 */
+  {0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e}, /* 5 */
+  {0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e}, /* 6 */
+  {0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}, /* 7 */
+  {0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e}, /* 8 */
+  {0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c}, /* 9 */
+  {0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e}, /* C */
+  {0x1c, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1c}, /* D */
+  {0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f}, /* E */
+  {0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f}, /* G */
+  {0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11}, /* H */
+  {0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e}, /* I */
+  {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f}, /* L */
+  {0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11}, /* M */
+  {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}, /* N */
+  {0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e}, /* O */
+  {0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10}, /* P */
+  {0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11}, /* R */
+  {0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e}, /* S */
+  {0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}  /* T */
+};
+
+/* in TextCache.fields order: two columns of two rows, left column first */
+const char *_text_labels[TEXT_FIELDS] = {"SCORE", "LENGTH", "SPEED", "TIME"};
+
+/* the number field f shows for snapshot s: speed in tenths of a move per second, time in seconds */
+Uint32 _text_value(int f, const Snapshot *s)
+{
+  switch (f) {
+  case 0:
+    return s->score;
+  case 1:
+    return s->length;
+  case 2:
+    return s->move_delay_ms > 0 ? (Uint32)((10000 + s->move_delay_ms / 2) / s->move_delay_ms) : 0;
+  default:
+    return s->play_seconds;
+  }
+}
+
+/* the characters of field f for value, label left and number right aligned, padded to the full
+ * width so the spaces of a shorter number leave the old glyphs out */
+void _text_format(int f, Uint32 value, char out[TEXT_FIELD_CHARS + 1])
+{
+  char number[TEXT_FIELD_CHARS + 1];
+
+  if (f == 2)
+    snprintf(number, sizeof(number), "%u.%u", (unsigned int)(value / 10), (unsigned int)(value % 10));
+  else if (f == 3)
+    snprintf(number, sizeof(number), "%u:%02u", (unsigned int)(value / 60), (unsigned int)(value % 60));
+  else
+    snprintf(number, sizeof(number), "%u", (unsigned int)value);
+  snprintf(out, TEXT_FIELD_CHARS + 1, "%-*.*s%*.*s", TEXT_LABEL_CHARS, TEXT_LABEL_CHARS, _text_labels[f],
+	   TEXT_FIELD_CHARS - TEXT_LABEL_CHARS, TEXT_FIELD_CHARS - TEXT_LABEL_CHARS, number);
+}
+
+/* turn field f's characters into glyphs and their quads, skipping spaces */
+void _text_lay_out(TextCache *t, int f, const char *text)
+{
+  TextField *field = t->fields + f;
+  SDL_Vertex *v = t->vertices + f * TEXT_FIELD_CHARS * 4;
+  SDL_Color color = {TEXT_COLOR, SDL_ALPHA_OPAQUE};
+  float x, y, w = (float)(TEXT_GLYPH_WIDTH * t->pixel), h = (float)(TEXT_GLYPH_HEIGHT * t->pixel);
+  float u0, u1;
+  int glyph;
+
+  field->glyph_count = 0;
+  if (field->slot.w == 0)
+    return;
+  for (int i = 0; i < TEXT_FIELD_CHARS && text[i] != '\0'; i++) {
+    glyph = t->glyph_of[(unsigned char)text[i] & 0x7f];
+    if (glyph == 0)
+      continue;
+    field->glyphs[field->glyph_count] = (Uint8)glyph;
+    field->origins[field->glyph_count].x = field->slot.x + i * (TEXT_GLYPH_WIDTH + 1) * t->pixel;
+    field->origins[field->glyph_count].y = field->slot.y;
+
+    x = (float)field->origins[field->glyph_count].x;
+    y = (float)field->origins[field->glyph_count].y;
+    u0 = (float)(glyph * (TEXT_GLYPH_WIDTH + 1)) / TEXT_ATLAS_WIDTH;
+    u1 = (float)(glyph * (TEXT_GLYPH_WIDTH + 1) + TEXT_GLYPH_WIDTH) / TEXT_ATLAS_WIDTH;
+    v[0].position.x = x;
+    v[0].position.y = y;
+    v[0].tex_coord.x = u0;
+    v[0].tex_coord.y = 0.0f;
+    v[1].position.x = x + w;
+    v[1].position.y = y;
+    v[1].tex_coord.x = u1;
+    v[1].tex_coord.y = 0.0f;
+    v[2].position.x = x + w;
+    v[2].position.y = y + h;
+    v[2].tex_coord.x = u1;
+    v[2].tex_coord.y = 1.0f;
+    v[3].position.x = x;
+    v[3].position.y = y + h;
+    v[3].tex_coord.x = u0;
+    v[3].tex_coord.y = 1.0f;
+    for (int corner = 0; corner < 4; corner++)
+      v[corner].color = color;
+    v += 4;
+    field->glyph_count++;
+  }
+}
+
+/* bake the font into atlas_alpha, each glyph followed by an empty column so sampling never
+ * bleeds into its neighbour, and upload it as a texture if there is a renderer to draw it */
+void text_initialize(TextCache *t, SDL_Renderer *r)
+{
+  const char *charset = TEXT_CHARSET;
+  Uint32 pixels[TEXT_ATLAS_WIDTH * TEXT_GLYPH_HEIGHT];
+  Uint8 *alpha;
+
+  memset(t, 0, sizeof(TextCache));
+  for (int g = 0; g < TEXT_ATLAS_GLYPHS; g++) {
+    t->glyph_of[(unsigned char)charset[g]] = (Uint8)g;
+    for (int y = 0; y < TEXT_GLYPH_HEIGHT; y++) {
+      alpha = t->atlas_alpha + y * TEXT_ATLAS_WIDTH + g * (TEXT_GLYPH_WIDTH + 1);
+      for (int x = 0; x < TEXT_GLYPH_WIDTH; x++)
+	alpha[x] = (_text_font[g][y] >> (TEXT_GLYPH_WIDTH - 1 - x)) & 1 ? 0xff : 0x00;
+    }
+  }
+  if (r == NULL)
+    return;
+
+  /* white, so the vertex color tints it */
+  for (int i = 0; i < TEXT_ATLAS_WIDTH * TEXT_GLYPH_HEIGHT; i++)
+    pixels[i] = ((Uint32)t->atlas_alpha[i] << 24) | 0x00ffffffu;
+  t->atlas = SDL_CreateTexture(r, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, TEXT_ATLAS_WIDTH,
+			       TEXT_GLYPH_HEIGHT);
+  if (t->atlas == NULL || SDL_UpdateTexture(t->atlas, NULL, pixels, TEXT_ATLAS_WIDTH * sizeof(Uint32)) != 0
+      || SDL_SetTextureBlendMode(t->atlas, SDL_BLENDMODE_BLEND) != 0) {
+    fprintf(stderr, "[error]: %s, the menu will have no text\n", SDL_GetError());
+    if (t->atlas != NULL)
+      SDL_DestroyTexture(t->atlas);
+    t->atlas = NULL;
+  }
+}
+
+void text_deinitialize(TextCache *t)
+{
+  if (t->atlas != NULL)
+    SDL_DestroyTexture(t->atlas);
+  t->atlas = NULL;
+}
+
+/* place the fields in the menu for the layout, two rows right of the telemetry bars and left
+ * of the exit button; fields that don't fit are left out. Every field is laid out again */
+void text_layout(TextCache *t, const Layout *l)
+{
+  int advance, width, height, gap, x, y;
+
+  t->pixel = SDL_max((int)(TEXT_SCALE * l->scale + 0.5f), 1);
+  advance = (TEXT_GLYPH_WIDTH + 1) * t->pixel;
+  width = TEXT_FIELD_CHARS * advance - t->pixel;
+  height = TEXT_GLYPH_HEIGHT * t->pixel;
+  gap = 2 * t->pixel;
+
+  for (int f = 0; f < TEXT_FIELDS; f++) {
+    /* right column, then the left one two characters before it */
+    x = l->exit_button.x - l->border - advance - width;
+    if (f < 2)
+      x -= width + 2 * advance;
+    y = l->menu.y + (l->menu.h - 2 * height - gap) / 2 + (f % 2) * (height + gap);
+    t->fields[f].slot.x = x;
+    t->fields[f].slot.y = y;
+    t->fields[f].slot.w = width;
+    t->fields[f].slot.h = height;
+    if (x < l->menu.x || y < l->menu.y) {
+      t->fields[f].slot.w = 0;
+      t->fields[f].slot.h = 0;
+    }
+    t->fields[f].valid = false;
+  }
+}
+
+/* lay out the fields whose number changed in snapshot s; true if any has to be drawn again */
+bool text_update(TextCache *t, const Snapshot *s)
+{
+  char text[TEXT_FIELD_CHARS + 1];
+  Uint32 value;
+  bool changed = false;
+
+  for (int f = 0; f < TEXT_FIELDS; f++) {
+    value = _text_value(f, s);
+    if (!t->fields[f].valid || t->fields[f].value != value) {
+      _text_format(f, value, text);
+      _text_lay_out(t, f, text);
+      t->fields[f].value = value;
+      t->fields[f].valid = true;
+      t->fields[f].dirty = true;
+    }
+    changed |= t->fields[f].dirty;
+  }
+  return changed;
+}
+
+/* fill indices with the quads of every field, or only the dirty ones, for one draw call over
+ * vertices; returns how many indices that is */
+int text_indices(TextCache *t, bool all)
+{
+  const int corners[6] = {0, 1, 2, 0, 2, 3};
+  int count = 0, first;
+
+  for (int f = 0; f < TEXT_FIELDS; f++) {
+    if (!all && !t->fields[f].dirty)
+      continue;
+    for (int g = 0; g < t->fields[f].glyph_count; g++) {
+      first = (f * TEXT_FIELD_CHARS + g) * 4;
+      for (int i = 0; i < 6; i++)
+	t->indices[count++] = first + corners[i];
+    }
+  }
+  return count;
+}
+
+/* the fields have been drawn as they are now */
+void text_drawn(TextCache *t)
+{
+  for (int f = 0; f < TEXT_FIELDS; f++)
+    t->fields[f].dirty = false;
+}
@@ -1,5 +1,7 @@
+#include <stdio.h>
 #include <stdbool.h>
 #include <SDL2/SDL.h>
+#include "constants.h"
 
 #ifndef SNAKE_TYPES_H
 #define SNAKE_TYPES_H
@@ -11,27 +13,503 @@ typedef struct {
   unsigned int y;
 } SnakeSegment, Food, Point;
 
+/* a block of memory allocated once and carved up front to back (arena.c) */
 typedef struct {
-  SnakeSegment *segments;
-  SnakeSegment segment_tail_previous;
+  unsigned char *base;
+  size_t size;
+  size_t used;
+} Arena;
+
+/* a PCG32 random number generator (rng.c), seeded with rng_seed. increment is odd and selects
+ * the stream, so generators with one seed and different streams never share a sequence */
+typedef struct {
+  Uint64 state;
+  Uint64 increment;
+} Rng;
+
+/* a snake on a width x height board, sized by snake_create. The body is stored as the cells at
+ * its two ends plus the direction of every step between them, 2 bits each, four to a byte:
+ * moves is a ring of those directions from the tail towards the head, running from move
+ * tail up to move head (exclusive), wrapping past the end of the ring. move_capacity is the
+ * smallest power of two that holds a snake filling the board, so the ring never has to grow.
+ * That is a 32nd of the memory of a ring of Points; walk the body with snake_iterate.
+ * occupancy has one bit per grid cell (index y * width + x), set while the body covers it.
+ * free_cells[0..free_cell_count) is a dense list of the cells the body does not cover, and
+ * free_cell_slot maps a free cell back to its position in that list, for O(1) removal */
+typedef struct {
+  unsigned int width;
+  unsigned int height;
+  unsigned int cell_count;
+  Point head_position;
+  Point tail_position;
+  Uint8 *moves;
+  unsigned int head;
+  unsigned int tail;
   unsigned int length;
-  unsigned int segment_buffer_size;
+  unsigned int move_capacity;
+  Uint64 *occupancy;
+  unsigned int *free_cells;
+  unsigned int *free_cell_slot;
+  unsigned int free_cell_count;
   Uint64 move_delay_ms;
-  Uint64 last_move_ms;
   Direction direction;
   Direction direction_queued;
   bool is_alive;
+  bool has_won; /* snake covers the whole board, there is nowhere left to place food */
   bool should_reset; /* Game has been unpaused after snake death */
 } Snake;
 
+/* a walk along a snake's body from the tail to the head, see snake_iterate */
+typedef struct {
+  const Snake *snake;
+  Point position; /* the segment snake_iterate_next returns next */
+  unsigned int move; /* the step from it to the one after */
+  unsigned int remaining;
+} SnakeIterator;
+
+/* decision timing for the autopilot, in performance counter units */
+typedef struct {
+  Uint64 decisions;
+  Uint64 decision_time;
+  Uint64 decision_max;
+  Uint64 searches; /* distance field rebuilds, one per food placed */
+  Uint64 search_time;
+} AutopilotStats;
+
+/* autopilot state for a width x height board (autopilot.c). cycle_index numbers the cells along
+ * a Hamiltonian cycle and cycle_cell maps the numbers back (NULL if the board has none);
+ * food_distance is a breadth-first distance field from field_food around the body as it was
+ * when that food appeared, and queue is the searches' scratch space. Without a cycle, reached
+ * marks the cells a move's look-ahead flood got to with that flood's number */
 typedef struct {
+  unsigned int width;
+  unsigned int height;
+  Uint32 *cycle_index;
+  Uint32 *cycle_cell;
+  Uint32 *food_distance;
+  Uint32 *queue;
+  Uint32 *reached;
+  Uint32 flood;
+  Uint32 field_food;
+  unsigned int field_length;
+  Uint32 expected_head; /* the cell the last decision moved into */
+  Uint32 settled; /* moves in a row made by the cycle's rules; the body is in cycle order once
+		   * it covers the whole snake */
+  AutopilotStats stats;
+} Autopilot;
+
+/* what draws the interactive game, see --renderer */
+typedef enum {
+  RENDER_BACKEND_AUTO, /* an accelerated SDL renderer, or the software backend without one */
+  RENDER_BACKEND_GPU, /* an accelerated SDL renderer or nothing */
+  RENDER_BACKEND_SOFTWARE /* the built-in rasterizer (render_software.c) */
+} RenderBackend;
+
+/* command line settings for the interactive game */
+typedef struct {
+  unsigned int frame_rate; /* frames per second, 0 for uncapped */
+  bool vsync;
+  bool report_timing; /* print tick and frame jitter on exit */
+  Uint64 move_delay_ms; /* time per move at the start of a game, 0 for the default */
+  bool telemetry; /* start with frame telemetry on, F3 toggles it at runtime */
+  const char *telemetry_csv; /* file to write every telemetry sample to, or NULL */
+  Uint32 render_delay_ms; /* stall every frame's render this long, to check ticks keep their pace */
+  bool autopilot; /* the built-in solver steers instead of the arrow keys */
+  RenderBackend render_backend;
+  const char *capture_directory; /* record every presented frame there, NULL for none */
+  bool capture_raw; /* one raw RGBA stream instead of numbered PNG files */
+  unsigned int board_width; /* cells, see --board */
+  unsigned int board_height;
+  Uint64 seed; /* for the food, see --seed; from the clock when not given */
+  const char *record_path; /* replay file to record the session into, NULL for none */
+  const char *share_name; /* shared memory to export the game into, NULL for none */
+} Options;
+
+/* running mean, deviation and maximum of a timing error, in milliseconds */
+typedef struct {
+  Uint64 count;
+  double sum;
+  double sum_squares;
+  double max;
+} JitterStats;
+
+/* the most recent LATENCY_SAMPLES_MAX samples of a latency, in milliseconds */
+typedef struct {
+  double samples[LATENCY_SAMPLES_MAX];
+  unsigned int next;
+  Uint64 count;
+} LatencySamples;
+
+/* what the game was doing while the main loop ran or slept, for --timing */
+typedef enum {
+  ACTIVITY_PLAYING,
+  ACTIVITY_PAUSED,
+  ACTIVITY_OVER, /* dead or won, waiting for a restart */
+  ACTIVITY_STATES
+} ActivityState;
+
+/* main loop wake-ups and the process's CPU time while the game was in one ActivityState */
+typedef struct {
+  double seconds;
+  double cpu_seconds;
+  Uint64 wakeups;
+} LoopActivity;
+
+/* the phases of a frame timed by the telemetry, in the order loop() runs them */
+typedef enum {
+  TELEMETRY_INPUT,
+  TELEMETRY_UPDATE,
+  TELEMETRY_RENDER,
+  TELEMETRY_PRESENT,
+  TELEMETRY_PHASES
+} TelemetryPhase;
+
+typedef struct {
+  Uint64 frame;
+  Uint32 phase_us[TELEMETRY_PHASES];
+} TelemetrySample;
+
+/* per-phase frame timings (telemetry.c). The game loop is the only producer into ring and
+ * telemetry_drain the only consumer, which folds samples into the histograms and the CSV file;
+ * ring_write and ring_read count samples and only ever increase */
+typedef struct {
+  bool enabled;
+  bool in_frame; /* enabled when the current frame started, so a toggle waits for the next one */
+  Uint64 frame;
+  Uint64 mark; /* performance counter at the end of the last phase */
+  TelemetrySample current;
+  TelemetrySample last; /* the last complete frame, for the overlay */
+  TelemetrySample ring[TELEMETRY_RING_SIZE];
+  SDL_atomic_t ring_write;
+  SDL_atomic_t ring_read;
+  Uint64 dropped; /* samples lost to a full ring */
+  Uint64 samples;
+  Uint32 histogram[TELEMETRY_PHASES][TELEMETRY_BUCKETS];
+  Uint32 max_us[TELEMETRY_PHASES];
+  FILE *csv;
+} Telemetry;
+
+/* frame capture (capture.c): the main thread copies each presented frame into buffers[write %
+ * CAPTURE_BUFFERS] and a writer thread saves them to disk in order. write and read count frames
+ * and only increase; a frame that finds every buffer still waiting is dropped, never waited for.
+ * Frames are only drawn when the game changes, so the writer also logs when each one was drawn */
+typedef struct {
+  Arena *arena; /* the buffers, allocated once */
+  Uint8 *buffers[CAPTURE_BUFFERS];
+  bool buffer_argb[CAPTURE_BUFFERS]; /* ARGB8888 words from the software backend, not RGBA bytes */
+  Uint64 buffer_counter[CAPTURE_BUFFERS]; /* performance counter when the frame was drawn */
+  Uint64 start_counter; /* when recording started */
+  Uint8 *png_rows; /* writer's scratch: the image with a filter byte before every row */
+  SDL_atomic_t write;
+  SDL_atomic_t read;
+  SDL_Thread *thread;
+  SDL_sem *wake;
+  SDL_atomic_t running;
+  int width; /* of every frame; the window can't be resized while recording, but the display
+	      * scale can still change the output size */
+  int height;
+  bool png; /* numbered PNG files, otherwise one stream of raw RGBA frames */
+  const char *directory;
+  FILE *raw;
+  FILE *timestamps; /* timestamps.txt: ms from start_counter to each written frame, one per line */
+  Uint32 crc_table[256];
+  Uint64 captured; /* main thread only */
+  Uint64 dropped; /* main thread only */
+  Uint64 mismatched; /* main thread only: frames not width x height, never captured */
+  Uint64 written; /* writer thread only */
+  Uint64 failed; /* writer thread only */
+} Capture;
+
+typedef struct {
+  Direction direction;
+  Uint32 timestamp_ms; /* SDL event timestamp of the key press */
+} Turn;
+
+/* where a replay keyframe is: the tick it was taken before and its offset in the file */
+typedef struct {
+  Uint64 tick;
+  Uint64 offset;
+} ReplayKeyframe;
+
+/* replay recording (replay.c): the direction of every tick, run-length encoded, with keyframes
+ * listed in index for the end of the file. Only the simulation thread writes it, through a
+ * stdio buffer allocated with the rest of the game */
+typedef struct {
+  FILE *file;
+  char *buffer;
+  Uint8 *scratch; /* one keyframe */
+  ReplayKeyframe *index;
+  unsigned int keyframes;
+  Uint64 ticks; /* recorded so far, over every game */
+  Uint64 offset; /* bytes written so far */
+  Direction run_direction;
+  unsigned int run_length; /* ticks of the run not written yet, 0 for none */
+  /* the game after the last recorded tick, for the footer */
+  Uint64 end_tick;
+  Uint32 end_score;
+  Uint32 end_head; /* cell, y * width + x */
+  bool failed;
+} ReplayWriter;
+
+/* the shared memory region of --share (share.c), as bots in other processes map it: this
+ * header, then occupancy_words words of the occupancy bitmap. Everything after command is a
+ * snapshot of the game written under sequence, a seqlock: odd while the game is writing, so a
+ * reader copies the snapshot and tries again if sequence was odd or changed meanwhile. command
+ * belongs to the bot: the number of its latest command << 2 | the direction, numbered from 1 */
+typedef struct {
+  char magic[4]; /* "SNKS" */
+  Uint32 version;
+  Uint32 width;
+  Uint32 height;
+  Uint32 occupancy_words;
+  SDL_atomic_t open; /* cleared when the game exits */
+  SDL_atomic_t sequence;
+  SDL_atomic_t command;
+  Uint64 publish_ns; /* CLOCK_MONOTONIC when the snapshot was written */
+  Uint64 tick;
+  Uint64 command_tick; /* the tick command_applied was applied on */
+  Uint64 command_ns; /* CLOCK_MONOTONIC when it was */
+  Uint32 command_applied; /* number of the last command the game took, 0 for none */
+  Uint32 head_x;
+  Uint32 head_y;
+  Uint32 tail_x;
+  Uint32 tail_y;
+  Uint32 food_x;
+  Uint32 food_y;
+  Uint32 score;
+  Uint32 length;
+  Uint32 direction;
+  Uint8 is_alive;
+  Uint8 has_won;
+  Uint8 is_paused;
+  Uint8 padding[5];
+} SharedState;
+
+/* the game's end of --share (share.c): the mapped region, and the last command taken from it,
+ * which goes out with the next snapshot. Only the simulation thread uses it after share_open */
+typedef struct {
+  SharedState *region;
+  Uint64 *occupancy; /* in the region, after the header */
+  size_t size;
+  const char *name;
+  int command_seen; /* command word last read */
+  Uint32 command_applied;
+  Uint64 command_tick;
+  Uint64 command_ns;
+  Uint64 published;
+  Uint64 commands;
+} Share;
+
+/* what the renderer needs of a game, copied out by the simulation thread after every update
+ * (sim.c); the body is just its occupancy bitset, which is all drawing it takes, allocated by
+ * sim_start to the snake's size */
+typedef struct {
+  Uint64 *occupancy;
+  Point head;
+  Food food;
+  Direction direction;
+  Uint64 tick;
+  Uint32 game; /* state->games when published, so the main thread can tell a restart */
+  unsigned int score;
+  unsigned int length;
+  Uint32 play_seconds; /* how long this game has been played, not counting pauses */
+  Uint64 move_delay_ms;
+  bool is_alive;
+  bool has_won;
+  bool is_paused;
+} Snapshot;
+
+/* where things are in the window, in pixels, worked out by render.c for the renderer's output
+ * size. scale is pixels per window coordinate, above 1 on HiDPI displays; mouse events come in
+ * window coordinates */
+typedef struct {
+  int width;
+  int height;
+  float scale;
+  int border; /* WINDOW_BORDER_THICKNESS, scaled */
+  SDL_Rect menu;
+  SDL_Rect exit_button;
+  SDL_Rect grid; /* inside the border, below the menu */
+} Layout;
+
+/* the pixels of one grid column or row: the first one, just inside its grid line, and how many */
+typedef struct {
+  int start;
+  int size;
+} RenderSpan;
+
+/* one number in the menu with its label (text.c). value is what the glyphs were laid out from,
+ * so they are only laid out again when it changes; dirty is set from then until they are drawn */
+typedef struct {
+  Uint32 value;
+  bool valid; /* value has been laid out for the current layout */
+  bool dirty;
+  SDL_Rect slot; /* pixels the field covers, cleared before it is redrawn; empty if it doesn't fit */
+  int glyph_count; /* characters drawn, spaces are skipped */
+  Uint8 glyphs[TEXT_FIELD_CHARS]; /* atlas glyph of each */
+  SDL_Point origins[TEXT_FIELD_CHARS]; /* top left pixel of each */
+} TextField;
+
+/* the menu text (text.c): the font is baked once into atlas_alpha, one byte of coverage per
+ * font pixel, and for the GPU into the atlas texture. Field f's glyphs are quads at
+ * vertices[f * TEXT_FIELD_CHARS * 4 ...], and indices is scratch for the ones submitted */
+typedef struct {
+  Uint8 atlas_alpha[TEXT_ATLAS_WIDTH * TEXT_GLYPH_HEIGHT];
+  SDL_Texture *atlas; /* NULL for the software backend */
+  Uint8 glyph_of[128]; /* atlas glyph of each ASCII character, 0 (space) if the font lacks it */
+  int pixel; /* screen pixels per font pixel */
+  TextField fields[TEXT_FIELDS];
+  SDL_Vertex vertices[TEXT_FIELDS * TEXT_FIELD_CHARS * 4];
+  int indices[TEXT_FIELDS * TEXT_FIELD_CHARS * 6];
+} TextCache;
+
+/* renderer-side buffers, built once by render_initialize and reused every frame */
+typedef struct {
+  unsigned int board_width;
+  unsigned int board_height;
+  unsigned int occupancy_words;
+  /* cells are filled in batches of RENDER_CELL_BATCH, snake and empty cells separately;
+   * a batch is submitted when it fills up and at the end of the frame */
+  SDL_Rect *snake_rects;
+  SDL_Rect *empty_rects;
+  int snake_count;
+  int empty_count;
+  /* cell geometry for the current layout, redone on resize, so a cell's rect is columns[x]
+   * and rows[y] */
+  RenderSpan *columns;
+  RenderSpan *rows;
+  bool grid_lines; /* cells are big enough to have grid lines between them */
+  SDL_Texture *static_layer; /* border, menu and grid; NULL if render targets are unsupported */
+  SDL_Texture *canvas; /* static layer plus snake and food, patched cell by cell */
+  bool static_layer_dirty;
+  bool canvas_dirty;
+  bool exit_button_hover;
+  int overlay_presented; /* overlay kind on screen, to notice pause and death without cell changes */
+  bool telemetry_presented; /* telemetry bars are on screen */
+  /* the board in the canvas, diffed against each new snapshot to find the cells to repaint */
+  Uint64 *presented_occupancy;
+  Food presented_food;
+  bool presented_food_visible;
+  TextCache text; /* drawn into the canvas with the board, so unchanged numbers cost nothing */
+  /* software backend: the frame is drawn into pixel buffers (ARGB8888, software_width pixels
+   * a row) from their own arena, reallocated on resize, and uploaded once per frame through
+   * software_texture, which is NULL when there is no window to show it in. software_frame is
+   * the canvas with the overlays on top */
+  bool software;
+  int software_width;
+  int software_height;
+  Arena *software_arena;
+  Uint32 *software_static;
+  Uint32 *software_canvas;
+  Uint32 *software_frame;
+  Uint32 *software_presented; /* whichever of the two was uploaded last */
+  SDL_Texture *software_texture;
+} RenderCache;
+
+typedef struct {
+  Arena *arena; /* holds the GameState itself and everything below, allocated at startup */
   SDL_Window *window;
   SDL_Renderer *renderer;
-  bool is_running;
+  RenderCache *render_cache;
+  Layout layout;
+  bool is_running; /* main thread only; the simulation thread stops on sim_running */
   bool is_paused;
   unsigned int score;
+  Uint64 tick; /* logical ticks since the last reset, one per snake move */
+  Uint32 games; /* resets so far, i.e. the number of the game being played */
+  Uint64 play_time; /* performance counter units played since the last reset, pauses excluded */
+  Sint64 tick_accumulator; /* time owed to the simulation, in performance counter units */
+  JitterStats tick_jitter; /* how late ticks ran against their fixed schedule */
+  JitterStats frame_jitter; /* how far frame intervals strayed from the target frame rate */
+  LoopActivity loop_activity[ACTIVITY_STATES];
+  Options options;
+  /* turns waiting for a tick: a single-producer, single-consumer ring written by the main thread
+   * and read by the simulation thread, turn_write and turn_read count turns and only increase */
+  Turn turns[INPUT_QUEUE_SIZE];
+  SDL_atomic_t turn_write;
+  SDL_atomic_t turn_read;
+  /* main thread only: the direction of the last turn queued in game turn_game, which the next
+   * one is checked against */
+  Direction turn_last;
+  Uint32 turn_game;
+  SDL_atomic_t turn_restart; /* turn_write at the last restart press; a reset drops older turns */
+  LatencySamples input_latency; /* key press to the tick that turned the snake */
+  Telemetry *telemetry;
+  Capture *capture; /* NULL unless recording */
+  bool exit_button_hover; /* kept by the event filter from mouse motion */
   Snake *snake;
   Food food;
+  Rng rng; /* where food appears; games follow one another on the same stream */
+  Autopilot *autopilot; /* NULL unless a bot plays through policy_autopilot */
+  ReplayWriter *replay; /* NULL unless recording, see --record */
+  Share *share; /* NULL unless exported, see --share */
+  /* simulation thread (sim.c). It owns the game fields above; the main thread only sees the
+   * game through snapshots, and talks back through the turn ring and pause_presses */
+  SDL_Thread *sim_thread;
+  SDL_sem *sim_wake; /* posted to wake the simulation before its next tick is due */
+  SDL_atomic_t sim_running;
+  SDL_atomic_t pause_presses; /* P / Space presses not yet seen by the simulation */
+  /* the simulation pushes an SDL event of this type to wake the main loop when it publishes a
+   * snapshot, unless one is already pending, i.e. snapshot_event_pending is set */
+  Uint32 snapshot_event;
+  SDL_atomic_t snapshot_event_pending;
+  /* lock-free triple buffer: the simulation writes snapshots[snapshot_back], the renderer reads
+   * snapshots[snapshot_front], and snapshot_middle is swapped with either, with SNAPSHOT_FRESH
+   * set while it holds a snapshot the renderer has not picked up */
+  Snapshot snapshots[3];
+  SDL_atomic_t snapshot_middle;
+  unsigned int snapshot_back;
+  unsigned int snapshot_front;
 } GameState;
 
-#endif /* SNAKE_TYPES_H */
\ No newline at end of file
+/* many games stepped in lockstep (batch.c), stored as structure-of-arrays so every phase of a
+ * tick is a straight loop over the games that the compiler can vectorize. Game g's occupancy
+ * bitset is occupancy[g * OCCUPANCY_WORDS ...] and its body is a ring of cell indices in
+ * body[g * GRID_CELL_COUNT ...], from body_tail[g] to body_head[g] */
+typedef struct {
+  unsigned int count;
+  Sint32 *head_x;
+  Sint32 *head_y;
+  Sint32 *next_x;
+  Sint32 *next_y;
+  Sint32 *food_x;
+  Sint32 *food_y;
+  Uint32 *direction;
+  Uint32 *length;
+  Uint32 *score;
+  Uint32 *ticks;
+  Uint32 *body_head;
+  Uint32 *body_tail;
+  Uint32 *ate; /* set for the games that ate on the last step */
+  Uint32 *done; /* set for the games that died or filled the board on the last step, and were reset */
+  Uint32 *done_score; /* final score of those games */
+  Uint64 *occupancy;
+  Uint16 *body;
+  Rng rng; /* food for every game, drawn in game order */
+} Batch;
+
+/* arena mode (swarm.c): count snakes and their food on one width x height board. owner holds,
+ * per cell, 0 if empty, SWARM_FOOD, or the id + 1 of the snake whose body covers it, so every
+ * collision and food check is one lookup. claims is written during a tick by the snakes moving
+ * into each cell. Snake i's body is a ring of cell indices in body[i * SWARM_MAX_LENGTH ...],
+ * from body_tail[i] to body_head[i] */
+typedef struct {
+  Arena *arena; /* holds the Swarm itself, everything below and the thread pool's lists */
+  unsigned int count;
+  unsigned int width;
+  unsigned int height;
+  Uint32 *owner;
+  SDL_atomic_t *claims;
+  Uint32 *body;
+  Uint32 *body_head;
+  Uint32 *body_tail;
+  Uint32 *length;
+  Uint32 *score;
+  Uint32 *target; /* cell snake i moves into this tick, SWARM_NO_CELL if it crashed */
+  Uint8 *direction;
+  Uint8 *alive;
+  Uint64 tick;
+  Rng rng; /* spawns and food, only drawn from in the serial phase */
+} Swarm;
+
+#endif /* SNAKE_TYPES_H */
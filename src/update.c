@@ -5,156 +5,234 @@
 #include "types.h"
 #include "logic.h"
 
-Snake * snake_initialize(void);
-void snake_deinitialize(Snake *s);
+void snake_initialize(Snake *s);
+void snake_push_head(Snake *s, Direction d);
+void snake_pop_tail(Snake *s);
+
+/* rng.c functions */
+Uint32 rng_below(Rng *r, Uint32 bound);
+
+/* policy.c functions */
+Direction policy_autopilot(GameState *state);
+
+/* replay.c functions */
+void replay_record(ReplayWriter *w, GameState *state, Direction action);
+void replay_stepped(ReplayWriter *w, GameState *state);
+
+/* share.c functions */
+void share_publish(Share *share, GameState *state);
+void share_take_command(Share *share, GameState *state, Direction *action);
 
 bool _incoming_collision(Snake *s)
 {
-  Point head = *(s->segments);
-  Point upcoming_position = s->segments[0];
-  switch (s->direction_queued) {
-    case NORTH:
-      if (head.y == 0) return true;
-      upcoming_position.y--;
-      break;
-    case SOUTH:
-      if (head.y + 1 == GRID_COUNT_Y) return true;
-      upcoming_position.y++;
-      break;
-    case EAST:
-      if (head.x + 1 == GRID_COUNT_X) return true;
-      upcoming_position.x++;
-      break;
-    case WEST:
-      if (head.x == 0) return true;
-      upcoming_position.x--;
-      break;
-    default:
-      fprintf(stderr, "[error]: unknown enum Direction [%i] in snake->direction_queued\n", s->direction_queued);
-      break;
-  }
-  if (is_point_in_array(&upcoming_position, s->segments, s->length))
+  Point upcoming_position;
+
+  if (!point_step(&(s->head_position), s->direction_queued, s->width, s->height, &upcoming_position))
+    return true;
+  if (is_point_occupied(&upcoming_position, s))
     return true;
   
   return false;
 }
 
 
-void _update_snake_position(Snake *snake)
+/* returns true if the snake moved */
+/* only the new head is written; the tail is dropped afterwards by _update_snake_eat_food */
+bool _update_snake_position(Snake *snake)
 {
-  unsigned int s_length = snake->length;
+  /* use a queued direction to prevent doubling back on self */
+  snake->direction = snake->direction_queued;
 
-  /* is it time to move the snake? */
-  if (SDL_GetTicks64() >= snake->last_move_ms + snake->move_delay_ms) {
-    /* use a queued direction to prevent doubling back on self */
-    snake->direction = snake->direction_queued;
+  /* is the snake about to run into something? */
+  if (_incoming_collision(snake)) {
+    snake->is_alive = false;
+    return false;
+  }
 
-    /* is the snake about to run into something? */
-    if (_incoming_collision(snake)) {
-      snake->is_alive = false;
-      return;
-    }
+  snake_push_head(snake, snake->direction);
+  return true;
+}
 
-    
-    /* save the tail segment in case the snake eats some food */
-    SnakeSegment *segment_tail_previous = (snake->segments + snake->length - 1);
-    snake->segment_tail_previous.x = segment_tail_previous->x;
-    snake->segment_tail_previous.y = segment_tail_previous->y;
-
-    for (unsigned int i = s_length; i > 0; i--) {
-      SnakeSegment *seg = snake->segments + i -1;
-      if (i - 1 == 0) { /* head element gets moved in direction */
-        switch (snake->direction) {
-        case NORTH:
-          seg->y--;
-          break;
-        case EAST:
-          seg->x++;
-          break;
-        case SOUTH:
-          seg->y++;
-          break;
-        case WEST:
-          seg->x--;
-          break;
-        default: /* Something bad happened */
-          fprintf(stderr, "[error]: unknown direction %i\n", snake->direction);
-          break;
-        }
-      } else { /* Not the head element, so move it to the position of element -1 index in array */
-        seg->x = (seg - 1)->x;
-        seg->y = (seg - 1)->y;
-      }
-    } /* end for loop */
-
-    snake->last_move_ms = SDL_GetTicks64();
-  } /* end if update snake position */
+/* draw the food uniformly from the free cell list; returns false if the board is full */
+bool _update_randomize_food_location(Food *food, Snake *snake, Rng *rng) {
+  unsigned int cell;
 
+  if (snake->free_cell_count == 0)
+    return false;
+  cell = snake->free_cells[rng_below(rng, snake->free_cell_count)];
+  food->x = cell % snake->width;
+  food->y = cell / snake->width;
+  return true;
 }
 
-void _update_randomize_food_location(Food *food, Snake *snake) {
-  Food new_food = {0, 0};
-  do {
-    new_food.x = rand() % GRID_COUNT_X;
-    new_food.y = rand() % GRID_COUNT_Y;
-  } while (is_point_in_array(&new_food, snake->segments, snake->length));
-  food->x = new_food.x;
-  food->y = new_food.y;
-}
+/* called after each move: the snake grows by keeping its tail, otherwise the tail is dropped */
+/* returns true if the snake ate */
+bool _update_snake_eat_food(Snake *snake, Food *food, Rng *rng) {
+  SnakeSegment *head = &(snake->head_position);
 
-void _update_snake_eat_food(Snake *snake, Food *food) {
   /* does snake head position == food position? */
-  if (snake->segments->x == food->x && snake->segments->y == food->y) {
-    snake->length++;
-    /* realloc snake->segments if needed */
-    if (snake->length * sizeof(SnakeSegment) >= snake->segment_buffer_size) {
-      snake->segment_buffer_size *= 2;
-      snake->segments = realloc(snake->segments, snake->segment_buffer_size);
-      if (snake->segments == NULL) {
-	      fprintf(stderr, "[error]: failed to reallocate space for snake segments");
-      }
-    } /* endif realloc snake->segments */
-    SnakeSegment *tail = (snake->segments + snake->length - 1);
-    tail->x = snake->segment_tail_previous.x;
-    tail->y = snake->segment_tail_previous.y;
-
-    _update_randomize_food_location(food, snake);
-
-    if (snake->move_delay_ms - SNAKE_MOVE_DELAY_DECREMENT_MS >= SNAKE_MOVE_DELAY_MIN_MS)
+  if (head->x == food->x && head->y == food->y) {
+    if (!_update_randomize_food_location(food, snake, rng))
+      snake->has_won = true;
+
+    /* move_delay_ms is unsigned, and --move-ms can start it below the decrement */
+    if (snake->move_delay_ms >= SNAKE_MOVE_DELAY_MIN_MS + SNAKE_MOVE_DELAY_DECREMENT_MS)
       snake->move_delay_ms -= SNAKE_MOVE_DELAY_DECREMENT_MS;
+    return true;
   } /* endif snake head position == food position */
+
+  snake_pop_tail(snake);
+  return false;
+}
+
+/* start a new game in place; the snake must already have been created by snake_create */
+bool reset(GameState *state)
+{
+  if (state->snake == NULL) {
+    fprintf(stderr, "[error]: Tried to reset a game without a Snake\n");
+    return false;
+  }
+  snake_initialize(state->snake);
+
+  state->score = 0;
+  state->tick = 0;
+  state->play_time = 0;
+  state->games++;
+  _update_randomize_food_location(&(state->food), state->snake, &(state->rng));
+  /* 0 keeps snake.c's default */
+  if (state->options.move_delay_ms > 0)
+    state->snake->move_delay_ms = state->options.move_delay_ms;
+  return true;
+}
+
+/* step is the whole simulation: advance the game by one logical tick, moving the snake one
+ * cell in direction action. It never reads the clock, so headless runs can call it as fast
+ * as they like and the interactive loop only decides when to call it */
+void step(GameState *state, Direction action)
+{
+  Snake *snake = state->snake;
+
+  if (snake->is_alive == false || snake->has_won)
+    return;
+
+  /* reversing would run the head straight into the neck, so keep going instead */
+  if (action != direction_opposite(snake->direction))
+    snake->direction_queued = action;
+
+  state->tick++;
+  if (!_update_snake_position(snake))
+    return;
+  if (_update_snake_eat_food(snake, &(state->food), &(state->rng)))
+    state->score++;
 }
 
-Snake * _update_reset_snake(Snake *s)
+/* a move takes move_delay_ms, in performance counter units */
+Sint64 _update_tick_length(Snake *snake)
 {
-  snake_deinitialize(s);
-  return snake_initialize();
+  return (Sint64)(snake->move_delay_ms * SDL_GetPerformanceFrequency() / 1000);
+}
+
+/* take the oldest queued turn, if any, as the coming tick's action, leaving step() to refuse
+ * a reversal; this is the consumer end of the turn ring, which process_input fills from the
+ * main thread */
+void _update_take_queued_turn(GameState *state, Direction *action)
+{
+  int read = SDL_AtomicGet(&(state->turn_read));
+  Turn *turn;
+
+  if (read == SDL_AtomicGet(&(state->turn_write)))
+    return;
+  SDL_MemoryBarrierAcquire();
+  turn = state->turns + ((unsigned int)read & (INPUT_QUEUE_SIZE - 1));
+  *action = turn->direction;
+  latency_record(&(state->input_latency), (double)(Uint32)(SDL_GetTicks() - turn->timestamp_ms));
+  SDL_MemoryBarrierRelease();
+  SDL_AtomicSet(&(state->turn_read), read + 1);
+}
+
+/* performance counter units until update() has a tick to run, or -1 while the game is paused,
+ * over, or waiting to restart, when only a key press can change anything */
+Sint64 update_time_to_next_tick(GameState *state)
+{
+  Snake *snake = state->snake;
+
+  if (snake->should_reset || !snake->is_alive || snake->has_won || state->is_paused)
+    return -1;
+  if (state->tick_accumulator >= _update_tick_length(snake))
+    return 0;
+  return _update_tick_length(snake) - state->tick_accumulator;
 }
 
 /* update function is only responsible for handling game logic */
-void update(GameState *state)
+/* elapsed is the time since the last call in performance counter units. It is added to an
+ * accumulator and every tick that has come due is run, so the snake keeps its speed even
+ * when the caller wakes up late. The interactive game calls it from the simulation thread */
+void update(GameState *state, Uint64 elapsed)
 {
   Snake *snake = state->snake;
-  Food *food = &(state->food);
+  Sint64 tick_length;
+  unsigned int ticks = 0;
+  int restart;
+  Direction action;
   
   /* wait for process_input to restart game */
   if (snake->should_reset) {
-    snake = _update_reset_snake(snake);
-    state->snake = snake;
+    if (!reset(state)) {
+      SDL_AtomicSet(&(state->sim_running), 0);
+      return;
+    }
+    /* give the player one extra move delay before the first move */
+    state->tick_accumulator = -_update_tick_length(state->snake);
+    /* drop the turns pressed before the restart; the consumer may skip ahead that far, and
+     * never back, should the restart press have looked like a pause to the main thread */
+    restart = SDL_AtomicGet(&(state->turn_restart));
+    if ((int)(restart - SDL_AtomicGet(&(state->turn_read))) > 0)
+      SDL_AtomicSet(&(state->turn_read), restart);
+    if (state->share != NULL)
+      share_publish(state->share, state);
+    return;
   }
     
-  if (snake->is_alive == false)
+  if (snake->is_alive == false || snake->has_won)
     return;
 
   if (state->is_paused) {
-    /* updated snake->last_move_ms to provide delay before unpausing */
-    snake->last_move_ms = SDL_GetTicks64();
+    /* a full move delay after unpausing, as at the start of a game */
+    state->tick_accumulator = 0;
     return;
   }
 
-  _update_snake_position(snake);
-  _update_snake_eat_food(snake, food);
-  
-  /* update snake position */
-  
+  state->tick_accumulator += elapsed;
+  state->play_time += elapsed;
+  tick_length = _update_tick_length(snake);
+  while (state->tick_accumulator >= tick_length && snake->is_alive && !snake->has_won) {
+    /* far behind, e.g. the window was being dragged: drop the backlog instead of fast forwarding */
+    if (ticks == UPDATE_MAX_TICKS_PER_FRAME) {
+      state->tick_accumulator = 0;
+      break;
+    }
+    jitter_record(&(state->tick_jitter),
+		  (double)(state->tick_accumulator - tick_length) * 1000.0 / SDL_GetPerformanceFrequency());
+    /* the autopilot plays instead of the keys, whose turns are left in the ring */
+    if (state->autopilot != NULL) {
+      action = policy_autopilot(state);
+    } else {
+      action = snake->direction_queued;
+      _update_take_queued_turn(state, &action);
+      /* a bot's command wins over the keys for this tick */
+      if (state->share != NULL)
+	share_take_command(state->share, state, &action);
+    }
+    if (state->replay != NULL)
+      replay_record(state->replay, state, action);
+    step(state, action);
+    if (state->replay != NULL)
+      replay_stepped(state->replay, state);
+    if (state->share != NULL)
+      share_publish(state->share, state);
+    state->tick_accumulator -= tick_length;
+    /* eating speeds the snake up */
+    tick_length = _update_tick_length(snake);
+    ticks++;
+  }
 }